@@ -0,0 +1,137 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+namespace testing {
+
+    // Samples of every benchmark in a run, saved to a file so later runs
+    // can be compared against them. Each benchmark is compared with its
+    // saved samples by a one-sided Mann-Whitney U test, which makes no
+    // assumption about the shape of the timing distribution. A benchmark
+    // has regressed when its median is more than threshold slower and
+    // the test is significant at alpha.
+    //
+    // The file is text: a header line, then one line per benchmark with
+    // its name, a tab, and the samples in microseconds.
+    class Baseline {
+        ::std::map<::std::string, ::std::vector<double>> saved;
+        ::std::vector<::std::pair<::std::string, ::std::vector<double>>> current;
+        static const char* Header() {
+            return "benchtest baseline 1";
+        }
+    public:
+        double threshold = 0.05;
+        double alpha = 0.01;
+        unsigned long regressions = 0;
+
+        // Replaces the saved samples only if the whole file reads.
+        bool Load(const ::std::string& path) {
+            ::std::ifstream in(path);
+            ::std::string line;
+            if (!::std::getline(in, line) || line != Header()) return false;
+            ::std::map<::std::string, ::std::vector<double>> loaded;
+            while (::std::getline(in, line)) {
+                auto tab = line.find('\t');
+                if (tab == ::std::string::npos) return false;
+                ::std::istringstream values(line.substr(tab + 1));
+                auto& v = loaded[line.substr(0, tab)];
+                double x;
+                while (values >> x) v.push_back(x);
+            }
+            saved.swap(loaded);
+            return true;
+        }
+
+        bool Save(const ::std::string& path) const {
+            ::std::ofstream out(path);
+            out << Header() << ::std::endl << ::std::setprecision(9);
+            for (auto& b : current) {
+                out << b.first << '\t';
+                const char* separator = "";
+                for (auto x : b.second) {
+                    out << separator << x;
+                    separator = " ";
+                }
+                out << ::std::endl;
+            }
+            out.close();
+            return !out.fail();
+        }
+
+        bool Empty() const {
+            return saved.empty();
+        }
+
+        // Samples kept for Save(), in the order they were added.
+        const ::std::vector<::std::pair<::std::string, ::std::vector<double>>>& Current() const {
+            return current;
+        }
+
+        // Keep samples for Save() without comparing them.
+        void Keep(const ::std::string& name, const ::std::vector<double>& samples) {
+            current.push_back(::std::make_pair(name, samples));
+        }
+
+        // Keep samples for Save() and fill the baseline fields of stats.
+        void Add(const ::std::string& name, const ::std::vector<double>& samples, Stats& stats) {
+            Keep(name, samples);
+            auto b = saved.find(name);
+            if (b == saved.end() || b->second.empty() || samples.empty()) return;
+            auto sorted = b->second;
+            ::std::sort(sorted.begin(), sorted.end());
+            size_t n = sorted.size();
+            stats.baseline_median = (sorted[(n - 1) / 2] + sorted[n / 2]) / 2;
+            stats.p_value = MannWhitney(samples, b->second);
+            stats.regression = stats.p_value < alpha && stats.median > stats.baseline_median * (1 + threshold);
+            if (stats.regression) ++regressions;
+        }
+
+        // One-sided p-value that values in a tend to be larger than in b,
+        // by the normal approximation with tie and continuity corrections.
+        static double MannWhitney(const ::std::vector<double>& a, const ::std::vector<double>& b) {
+            double na = a.size(), nb = b.size(), n = na + nb;
+            if (!na || !nb) return 1;
+            ::std::vector<::std::pair<double, bool>> all;
+            for (auto x : a) all.push_back(::std::make_pair(x, true));
+            for (auto x : b) all.push_back(::std::make_pair(x, false));
+            ::std::sort(all.begin(), all.end());
+            double rank_a = 0, ties = 0;
+            for (size_t i = 0; i < all.size();) {
+                size_t j = i;
+                while (j < all.size() && all[j].first == all[i].first) ++j;
+                double t = j - i;
+                double rank = (i + 1 + j) / 2.0;
+                for (size_t k = i; k < j; ++k) {
+                    if (all[k].second) rank_a += rank;
+                }
+                ties += t * t * t - t;
+                i = j;
+            }
+            double u = rank_a - na * (na + 1) / 2;
+            double variance = na * nb / 12 * ((n + 1) - ties / (n * (n - 1)));
+            if (variance <= 0) return 1;
+            double z = (u - na * nb / 2 - 0.5) / ::std::sqrt(variance);
+            return 0.5 * ::std::erfc(z / ::std::sqrt(2.0));
+        }
+    };
+
+    template<bool=true>
+    Baseline& baseline() {
+        static Baseline b;
+        return b;
+    }
+
+}
@@ -17,6 +17,14 @@
 #ifndef BENCHTEST_HPP
 #define BENCHTEST_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
 #include <chrono>
@@ -26,6 +34,29 @@
 #include <list>
 #include <complex>
 #include <cmath>
+#include <random>
+#include <thread>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+// Everything below is optional; without it the framework is portable
+// C++11 and the features that need it are left out.
+#if defined(__unix__) || defined(__APPLE__)
+#define BENCHTEST_POSIX 1
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BENCHTEST_X86 1
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 namespace testing {
 
@@ -40,7 +71,18 @@ namespace testing {
 
 #include "info.hpp"
 #include "printer.hpp"
+#include "tsc.hpp"
+#include "counters.hpp"
+#include "optimize.hpp"
+#include "cache.hpp"
+#include "threads.hpp"
+#include "sampler.hpp"
+#include "baseline.hpp"
+#include "interleave.hpp"
 #include "reporter.hpp"
+#include "host.hpp"
+#include "formats.hpp"
+#include "isolate.hpp"
 #include "asserter.hpp"
 #include "test.hpp"
 #include "runner.hpp"
@@ -76,5 +118,42 @@ BENCHTEST_F_(test_fixture, test_name, test_fixture)
 #define TEST_T(test_fixture, type_name, method_name) \
 BENCHTEST_T_(test_fixture, method_name, test_fixture, type_name) {method_name();}
 
+#define BENCHTEST_CAT_IMPL_(a, b) a##b
+#define BENCHTEST_CAT_(a, b) BENCHTEST_CAT_IMPL_(a, b)
+
+#define BENCHTEST_P_CLASS_NAME_(test_fixture, method_name) \
+test_fixture##_##method_name##_TestBench_P
+
+// Value-parameterized tests. The fixture is a template on a type and
+// a size and TEST_P declares a method of it as a test. One
+// INSTANTIATE_TEST_P after them registers every TEST_P of the fixture
+// for each of the types and every power of two size from first to
+// last. Reporters see the size in Info::size.
+//
+//     TEST_P(Sweep, fft);
+//     TEST_P(Sweep, four1);
+//     INSTANTIATE_TEST_P(Sweep, 8, 1 << 22, float, double);
+#define TEST_P(test_fixture, method_name) \
+template<typename BENCHTEST_T, size_t BENCHTEST_N> \
+class BENCHTEST_P_CLASS_NAME_(test_fixture, method_name) : public test_fixture<BENCHTEST_T, BENCHTEST_N> { \
+friend class ::testing::Factory<BENCHTEST_P_CLASS_NAME_(test_fixture, method_name)>; \
+public: \
+static ::testing::Info* test_info; \
+::testing::Info* TestInfo() { return test_info; } \
+void TestBody() { this->method_name(); } \
+}; \
+template<typename BENCHTEST_T, size_t BENCHTEST_N> \
+::testing::Info* BENCHTEST_P_CLASS_NAME_(test_fixture, method_name)<BENCHTEST_T, BENCHTEST_N>::test_info = nullptr; \
+template<> struct testing::ParamTest<test_fixture, __COUNTER__> { \
+static const bool declared = true; \
+template<typename BENCHTEST_T, size_t BENCHTEST_N> \
+using Test = BENCHTEST_P_CLASS_NAME_(test_fixture, method_name)<BENCHTEST_T, BENCHTEST_N>; \
+static const char* Name() { return #method_name; } \
+}
+
+#define INSTANTIATE_TEST_P(test_fixture, first, last, ...) \
+static ::testing::Instantiation<test_fixture, first, last, __COUNTER__, __VA_ARGS__> \
+BENCHTEST_CAT_(benchtest_params_, __LINE__)(#test_fixture, #__VA_ARGS__)
+
 
 #endif
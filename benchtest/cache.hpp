@@ -0,0 +1,65 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Removes data from the processor caches for cold cache benchmarks.
+    class Cache {
+    public:
+        // Size in bytes of the largest data cache, or 0 if unknown.
+        static size_t LastLevelSize() {
+            static const size_t size = [] {
+                long bytes = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+                bytes = ::std::max(bytes, ::sysconf(_SC_LEVEL3_CACHE_SIZE));
+                bytes = ::std::max(bytes, ::sysconf(_SC_LEVEL2_CACHE_SIZE));
+#endif
+                return size_t(bytes);
+            }();
+            return size;
+        }
+
+        // Write back and invalidate the cache lines holding [p, p+bytes).
+        // Returns false where that cannot be done directly.
+        static bool Flush(const void* p, size_t bytes) {
+#if defined(BENCHTEST_X86)
+            auto c = static_cast<const char*>(p);
+            for (size_t i = 0; i < bytes; i += 64) _mm_clflush(c + i);
+            if (bytes) _mm_clflush(c + bytes - 1);
+            _mm_mfence();
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // Evict everything by streaming through twice the largest cache,
+        // at most 1 GiB, or 64 MiB when the size is unknown. Slow on
+        // hosts with very large caches; prefer Flush() when the memory
+        // of interest is known.
+        static void Evict() {
+            static ::std::vector<char> buffer([] {
+                size_t llc = LastLevelSize();
+                return llc ? ::std::min(size_t(1) << 30, 2 * llc) : size_t(64) << 20;
+            }());
+            for (size_t i = 0; i < buffer.size(); i += 64) {
+                buffer[i] += 1;
+            }
+            ClobberMemory();
+        }
+    };
+
+}
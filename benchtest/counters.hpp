@@ -0,0 +1,134 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Hardware and software event counters for this thread from Linux
+    // perf_event_open. Events that cannot be opened, for example in a
+    // container or virtual machine without a PMU, or with a restrictive
+    // perf_event_paranoid, are left out. Elsewhere there are none.
+    // With more events than hardware counters the kernel multiplexes
+    // them, so each count comes with the time its group was enabled
+    // and the time it was actually counting; see Scale().
+    class Counters {
+        struct Event {
+            const char* name;
+            uint32_t type;
+            uint64_t config;
+        };
+        static const ::std::vector<Event>& Events() {
+#ifdef __linux__
+            static const ::std::vector<Event> events {
+                {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {"dTLB-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+                {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+            };
+#else
+            static const ::std::vector<Event> events;
+#endif
+            return events;
+        }
+        // Hardware and software events are counted in separate groups
+        // so each group can be read with one system call.
+        struct Group {
+            int leader = -1;
+            ::std::vector<int> fds;
+        };
+        Group groups[2];
+        ::std::vector<const char*> names;
+    public:
+        Counters() {
+#ifdef __linux__
+            for (int software = 0; software < 2; ++software) {
+                auto& g = groups[software];
+                for (auto& e : Events()) {
+                    if ((e.type == PERF_TYPE_SOFTWARE) != bool(software)) continue;
+                    perf_event_attr attr;
+                    ::std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = e.type;
+                    attr.config = e.config;
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    int fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, g.leader, 0);
+                    if (fd < 0) continue;
+                    if (g.leader < 0) g.leader = fd;
+                    g.fds.push_back(fd);
+                    names.push_back(e.name);
+                }
+            }
+#endif
+        }
+
+        ~Counters() {
+#ifdef __linux__
+            for (auto& g : groups) {
+                for (auto fd : g.fds) ::close(fd);
+            }
+#endif
+        }
+
+        Counters(const Counters&) = delete;
+        Counters& operator=(const Counters&) = delete;
+
+        // Names of the events that opened, in the order of Read().
+        const ::std::vector<const char*>& Names() const {
+            return names;
+        }
+
+        // Current value of every event that opened, followed by the
+        // nanoseconds each was enabled and then each was running, so
+        // 3 * Names().size() values that can be subtracted element-wise.
+        void Read(::std::vector<uint64_t>& values) const {
+            values.assign(3 * names.size(), 0);
+#ifdef __linux__
+            // nr, time_enabled, time_running, then one value per event.
+            uint64_t buffer[16];
+            size_t e = 0;
+            for (auto& g : groups) {
+                if (g.leader < 0) continue;
+                ssize_t n = ::read(g.leader, buffer, sizeof(buffer));
+                bool ok = n >= ssize_t(3 * sizeof(uint64_t));
+                for (size_t i = 0; i < g.fds.size(); ++i, ++e) {
+                    if (!ok || i >= buffer[0]) continue;
+                    values[e] = buffer[3 + i];
+                    values[names.size() + e] = buffer[1];
+                    values[2 * names.size() + e] = buffer[2];
+                }
+            }
+#endif
+        }
+
+        // Count of event i given the difference of two Read()s, or a sum
+        // of such differences, scaled up for the time it was not counting.
+        // False when it never counted, so there is no estimate.
+        bool Scale(const ::std::vector<double>& delta, size_t i, double& count) const {
+            double enabled = delta[names.size() + i];
+            double running = delta[2 * names.size() + i];
+            if (running <= 0) return false;
+            count = delta[i] * (enabled > running ? enabled / running : 1);
+            return true;
+        }
+    };
+
+}
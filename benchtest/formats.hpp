@@ -0,0 +1,333 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+namespace testing {
+
+    // Keeps every result and writes them all to out at the end, in a
+    // format for other programs. The usual progress goes to text, so
+    // out can be redirected to a file without mixing the two.
+    class RecordingReporter : public DefaultReporter {
+    public:
+        RecordingReporter(::std::ostream& out = ::std::cout, ::std::ostream& text = ::std::cerr) :
+        DefaultReporter(text),
+        out(&out) {
+        }
+    protected:
+        ::std::ostream* out;
+        struct Record {
+            ::std::string name;
+            ::std::string test_case;
+            ::std::string test;
+            ::std::string type;
+            size_t size;
+            bool threaded;
+            Stats stats;
+            ThreadStats thread_stats;
+            // Body of an interleaved comparison and the first body.
+            ::std::string body;
+            ::std::string versus;
+            double ratio;
+            double ratio_low;
+            double ratio_high;
+        };
+        ::std::vector<Record> records;
+
+        virtual void Write() = 0;
+
+        Record Current() {
+            Record r;
+            r.name = test_info->name();
+            r.test_case = test_info->test_case_base_name();
+            r.test = test_info->test_base_name();
+            r.type = test_info->type_param() ? test_info->type_param() : "";
+            r.size = test_info->size;
+            r.threaded = false;
+            r.ratio = r.ratio_low = r.ratio_high = 0;
+            return r;
+        }
+
+        virtual void Start(size_t cases, size_t total_qty) {
+            records.clear();
+            DefaultReporter::Start(cases, total_qty);
+        }
+
+        virtual void End(long ms) {
+            DefaultReporter::End(ms);
+            auto flags = out->flags();
+            auto precision = out->precision();
+            out->precision(10);
+            Write();
+            out->flags(flags);
+            out->precision(precision);
+            out->flush();
+        }
+
+        using DefaultReporter::Bench;
+
+        virtual void Bench(const Stats& stats) {
+            DefaultReporter::Bench(stats);
+            records.push_back(Current());
+            records.back().stats = stats;
+        }
+
+        virtual void Compare(const ::std::vector<Comparison>& bodies) {
+            DefaultReporter::Compare(bodies);
+            for (auto& c : bodies) {
+                records.push_back(Current());
+                auto& r = records.back();
+                r.stats = c.stats;
+                r.body = c.name;
+                r.versus = bodies[0].name;
+                r.ratio = c.ratio;
+                r.ratio_low = c.ratio_low;
+                r.ratio_high = c.ratio_high;
+            }
+        }
+
+        virtual void Threads(const ThreadStats& stats) {
+            DefaultReporter::Threads(stats);
+            records.push_back(Current());
+            records.back().threaded = true;
+            records.back().thread_stats = stats;
+        }
+    };
+
+
+    // One JSON document with a host object, a benchmarks array and the
+    // names of failed tests. Times are in microseconds; thread results
+    // are in calls per second.
+    class JsonReporter : public RecordingReporter {
+    public:
+        JsonReporter(::std::ostream& out = ::std::cout, ::std::ostream& text = ::std::cerr) :
+        RecordingReporter(out, text) {
+        }
+    protected:
+        void String(const ::std::string& s) {
+            *out << '"';
+            for (unsigned char ch : s) {
+                if (ch == '"' || ch == '\\') *out << '\\' << ch;
+                else if (ch == '\n') *out << "\\n";
+                else if (ch < 0x20) *out << "\\u" << ::std::hex << ::std::setw(4) << ::std::setfill('0') << int(ch) << ::std::dec << ::std::setfill(' ');
+                else *out << ch;
+            }
+            *out << '"';
+        }
+
+        void Number(double d) {
+            if (::std::isfinite(d)) *out << d;
+            else *out << "null";
+        }
+
+        void Key(const char* key) {
+            *out << '"' << key << "\": ";
+        }
+
+        void Field(const char* key, const ::std::string& value, bool comma = true) {
+            Key(key);
+            String(value);
+            if (comma) *out << ", ";
+        }
+
+        void Field(const char* key, double value, bool comma = true) {
+            Key(key);
+            Number(value);
+            if (comma) *out << ", ";
+        }
+
+        virtual void Write() {
+            *out << "{" << ::std::endl << "  ";
+            Key("host");
+            *out << "{";
+            Field("cpu", Host::Cpu());
+            Field("cores", ::testing::Threads::Cores());
+            Key("caches");
+            *out << "{";
+            const char* separator = "";
+            for (auto& c : Host::Caches()) {
+                *out << separator;
+                Field(c.first.c_str(), c.second, false);
+                separator = ", ";
+            }
+            *out << "}, ";
+            Field("compiler", Host::Compiler());
+            Field("flags", Host::Flags(), false);
+            *out << "}," << ::std::endl << "  ";
+            Key("benchmarks");
+            *out << "[";
+            separator = "";
+            for (auto& r : records) {
+                *out << separator << ::std::endl << "    {";
+                separator = ",";
+                Field("name", r.name);
+                Field("case", r.test_case);
+                Field("test", r.test);
+                Field("type", r.type);
+                // Only TEST_P instances know their size.
+                if (r.size) Field("size", r.size);
+                if (r.threaded) {
+                    auto& t = r.thread_stats;
+                    Field("threads", t.threads);
+                    Field("seconds", t.seconds);
+                    Field("rate", t.rate);
+                    Field("mean", t.mean);
+                    Field("stddev", t.stddev);
+                    Field("min", t.min);
+                    Field("max", t.max);
+                    Field("efficiency", t.efficiency, false);
+                } else {
+                    auto& s = r.stats;
+                    if (!r.body.empty()) {
+                        Field("body", r.body);
+                        Field("versus", r.versus);
+                        Field("ratio", r.ratio);
+                        Field("ratio_low", r.ratio_low);
+                        Field("ratio_high", r.ratio_high);
+                    }
+                    Field("cache", s.cache);
+                    Field("iterations", s.iterations);
+                    Field("batch", s.batch);
+                    Field("min", s.min);
+                    Field("median", s.median);
+                    Field("p90", s.p90);
+                    Field("p99", s.p99);
+                    Field("mean", s.mean);
+                    Field("stddev", s.stddev);
+                    Field("mad", s.mad);
+                    Field("ci_low", s.ci_low);
+                    Field("ci_high", s.ci_high);
+                    Field("cycles", s.cycles);
+                    if (s.baseline_median) {
+                        Field("baseline_median", s.baseline_median);
+                        Field("p_value", s.p_value);
+                        Key("regression");
+                        *out << (s.regression ? "true" : "false") << ", ";
+                    }
+                    Key("counters");
+                    *out << "{";
+                    const char* comma = "";
+                    for (auto& c : s.counters) {
+                        *out << comma;
+                        Field(c.first.c_str(), c.second, false);
+                        comma = ", ";
+                    }
+                    *out << "}";
+                }
+                *out << "}";
+            }
+            *out << ::std::endl << "  ]," << ::std::endl << "  ";
+            Key("failures");
+            *out << "[";
+            separator = "";
+            for (auto& f : failures) {
+                *out << separator;
+                String(f);
+                separator = ", ";
+            }
+            *out << "]" << ::std::endl << "}" << ::std::endl;
+        }
+    };
+
+
+    // One row for each benchmark after # comment lines describing the
+    // host. The size column is empty except for TEST_P instances.
+    // Rows from BenchmarkThreads() fill the thread columns and
+    // leave the timing columns empty, and the other way around. Each
+    // body of BenchmarkInterleaved() has a row with the ratio columns.
+    class CsvReporter : public RecordingReporter {
+    public:
+        CsvReporter(::std::ostream& out = ::std::cout, ::std::ostream& text = ::std::cerr) :
+        RecordingReporter(out, text) {
+        }
+    protected:
+        ::std::string Quote(const ::std::string& s) {
+            if (s.find_first_of(",\"\n") == ::std::string::npos) return s;
+            ::std::string q = "\"";
+            for (auto ch : s) {
+                if (ch == '"') q += '"';
+                q += ch;
+            }
+            return q + "\"";
+        }
+
+        virtual void Write() {
+            *out << "# cpu: " << Host::Cpu() << ::std::endl;
+            *out << "# cores: " << ::testing::Threads::Cores() << ::std::endl;
+            for (auto& c : Host::Caches()) {
+                *out << "# " << c.first << ": " << c.second << ::std::endl;
+            }
+            *out << "# compiler: " << Host::Compiler() << ::std::endl;
+            *out << "# flags: " << Host::Flags() << ::std::endl;
+            *out << "name,case,test,type,size,cache,iterations,batch,min,median,p90,p99,mean,stddev,mad,";
+            *out << "ci_low,ci_high,cycles,counters,threads,seconds,rate,rate_mean,rate_stddev,";
+            *out << "rate_min,rate_max,efficiency,baseline_median,p_value,regression,";
+            *out << "body,versus,ratio,ratio_low,ratio_high" << ::std::endl;
+            for (auto& r : records) {
+                *out << Quote(r.name) << "," << Quote(r.test_case) << "," << Quote(r.test) << ",";
+                *out << Quote(r.type) << ",";
+                if (r.size) *out << r.size;
+                *out << ",";
+                if (r.threaded) {
+                    auto& t = r.thread_stats;
+                    *out << ",,,,,,,,,,,,,,";
+                    *out << t.threads << "," << t.seconds << "," << t.rate << "," << t.mean << ",";
+                    *out << t.stddev << "," << t.min << "," << t.max << "," << t.efficiency << ",,,,,,,,";
+                } else {
+                    auto& s = r.stats;
+                    *out << s.cache << "," << s.iterations << "," << s.batch << ",";
+                    *out << s.min << "," << s.median << "," << s.p90 << "," << s.p99 << ",";
+                    *out << s.mean << "," << s.stddev << "," << s.mad << ",";
+                    *out << s.ci_low << "," << s.ci_high << "," << s.cycles << ",";
+                    // name=value pairs, so the column count doesn't
+                    // depend on which events could be opened.
+                    const char* separator = "";
+                    for (auto& c : s.counters) {
+                        *out << separator << c.first << "=" << c.second;
+                        separator = ";";
+                    }
+                    *out << ",,,,,,,,,";
+                    if (s.baseline_median) {
+                        *out << s.baseline_median << "," << s.p_value << "," << s.regression;
+                    } else {
+                        *out << ",,";
+                    }
+                    if (!r.body.empty()) {
+                        *out << "," << Quote(r.body) << "," << Quote(r.versus) << ",";
+                        *out << r.ratio << "," << r.ratio_low << "," << r.ratio_high;
+                    } else {
+                        *out << ",,,,,";
+                    }
+                }
+                *out << ::std::endl;
+            }
+        }
+    };
+
+
+    // Reporter for a format name: "json", "csv", or anything else for
+    // the usual text. Defaults to the BENCHTEST_FORMAT environment variable.
+    template<bool=true>
+    Reporter* NewReporter(const char* format = ::std::getenv("BENCHTEST_FORMAT")) {
+        ::std::string f = format ? format : "";
+        if (f == "json") return new JsonReporter;
+        if (f == "csv") return new CsvReporter;
+        if (!f.empty() && f != "text") {
+            ::std::cerr << "Unknown format " << f << ", using text." << ::std::endl;
+        }
+        return new DefaultReporter;
+    }
+
+}
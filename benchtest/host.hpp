@@ -0,0 +1,121 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+namespace testing {
+
+    // Describes the machine and build so saved results can be compared.
+    class Host {
+    public:
+        // Processor model name, or empty if unknown.
+        static ::std::string Cpu() {
+#if defined(BENCHTEST_X86)
+            unsigned a = 0, b = 0, c = 0, d = 0;
+            unsigned brand[12] = {0};
+            if (__get_cpuid(0x80000000, &a, &b, &c, &d) && a >= 0x80000004) {
+                for (unsigned i = 0; i < 3; ++i) {
+                    __get_cpuid(0x80000002 + i, &brand[i*4], &brand[i*4+1], &brand[i*4+2], &brand[i*4+3]);
+                }
+                auto model = reinterpret_cast<const char*>(brand);
+                ::std::string s(model, strnlen(model, sizeof(brand)));
+                s.erase(0, s.find_first_not_of(' '));
+                if (!s.empty()) return s;
+            }
+#endif
+            ::std::ifstream cpuinfo("/proc/cpuinfo");
+            ::std::string line;
+            while (::std::getline(cpuinfo, line)) {
+                if (line.compare(0, 10, "model name") && line.compare(0, 9, "Processor")) continue;
+                auto colon = line.find(':');
+                if (colon == ::std::string::npos) continue;
+                return line.substr(line.find_first_not_of(" \t", colon + 1));
+            }
+            return ::std::string();
+        }
+
+        // Size in bytes of each data cache level the system reports.
+        static ::std::vector<::std::pair<::std::string, size_t>> Caches() {
+            ::std::vector<::std::pair<::std::string, size_t>> caches;
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+            const char* names[] = {"L1d", "L2", "L3", "L4"};
+            long sizes[] = {
+                ::sysconf(_SC_LEVEL1_DCACHE_SIZE),
+                ::sysconf(_SC_LEVEL2_CACHE_SIZE),
+                ::sysconf(_SC_LEVEL3_CACHE_SIZE),
+                ::sysconf(_SC_LEVEL4_CACHE_SIZE)
+            };
+            for (int i = 0; i < 4; ++i) {
+                if (sizes[i] > 0) caches.push_back(::std::make_pair(names[i], size_t(sizes[i])));
+            }
+#endif
+            return caches;
+        }
+
+        static ::std::string Compiler() {
+#if defined(__clang__)
+            return "clang " __clang_version__;
+#elif defined(__GNUC__)
+            return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+            return "msvc " + ::std::to_string(_MSC_FULL_VER);
+#else
+            return ::std::string();
+#endif
+        }
+
+        // The command line can't be recovered at run time, so unless it
+        // is given with -DBENCHTEST_FLAGS='"..."' this lists the flags
+        // implied by the predefined macros. Those can't tell -O1 from
+        // -O3, so any of them shows as "optimized".
+        static ::std::string Flags() {
+#if defined(BENCHTEST_FLAGS)
+            return BENCHTEST_FLAGS;
+#else
+            ::std::string flags = "-std=c++";
+            if (__cplusplus >= 201703L) flags += "17";
+            else if (__cplusplus >= 201402L) flags += "14";
+            else flags += "11";
+#if defined(__OPTIMIZE_SIZE__)
+            flags += " -Os";
+#elif defined(__OPTIMIZE__)
+            flags += " optimized";
+#endif
+#if defined(__FAST_MATH__)
+            flags += " -ffast-math";
+#endif
+#if defined(NDEBUG)
+            flags += " -DNDEBUG";
+#endif
+#if defined(__AVX512F__)
+            flags += " -mavx512f";
+#endif
+#if defined(__AVX2__)
+            flags += " -mavx2";
+#elif defined(__AVX__)
+            flags += " -mavx";
+#endif
+#if defined(__FMA__)
+            flags += " -mfma";
+#endif
+#if defined(__ARM_NEON)
+            flags += " -mfpu=neon";
+#endif
+            return flags;
+#endif
+        }
+    };
+
+}
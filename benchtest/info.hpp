@@ -23,10 +23,11 @@ namespace testing {
         const char* type_name;
         virtual class Test* CreateFixture() = 0;
     protected:
-        Info(const char* case_name, const char* test_name, const char* type_name) :
+        Info(const char* case_name, const char* test_name, const char* type_name, size_t size = 0) :
         case_name(case_name),
         test_name(test_name),
-        type_name(type_name) {
+        type_name(type_name),
+        size(size) {
             if (::std::string(type_name).size() == 0) {
                 this->type_name = nullptr;
             }
@@ -36,17 +37,33 @@ namespace testing {
         virtual void TearDownTestCase() = 0;
         int fatal_failure_count = 0;
         int nonfatal_failure_count = 0;
+        // Problem size of a TEST_P instance, otherwise 0.
+        const size_t size;
         
         ::std::string test_case_name() const {
             auto n = ::std::string(case_name);
-            if (type_name) {
+            if (type_name || size) {
                 n += "<";
-                n += type_name;
+                if (type_name) n += type_name;
+                if (type_name && size) n += ",";
+                if (size) n += ::std::to_string(size);
                 n += ">";
             }
             return n;
         }
         
+        // Parts of name() for reporters that keep them apart.
+        const char* test_case_base_name() const {
+            return case_name;
+        }
+        const char* test_base_name() const {
+            return test_name;
+        }
+        // Type of a TEST_T or TEST_P instance, otherwise nullptr.
+        const char* type_param() const {
+            return type_name;
+        }
+        
         ::std::string name() const {
             auto n = test_case_name();
             n += ".";
@@ -0,0 +1,157 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+namespace testing {
+
+    // One body of an interleaved comparison.
+    struct Comparison {
+        ::std::string name;
+        // Times of this body alone.
+        Stats stats;
+        // Median over rounds of this body's time over the first body's
+        // time in the same round, with its 95% confidence interval.
+        double ratio = 1;
+        double ratio_low = 1;
+        double ratio_high = 1;
+    };
+
+    // Times two or more bodies with their samples interleaved, so all
+    // of them see the same clock speed, temperature and background load.
+    // Each round takes one sample of every body in a shuffled order.
+    // Ratios to the first body are taken within rounds, which cancels
+    // the drift that makes separate runs hard to compare on busy hosts.
+    //
+    //     Interleave ab({{"four1tmpl", a}, {"fft", b}});
+    //     auto result = ab.Run();
+    //     // result[1].ratio is fft time over four1tmpl time.
+    class Interleave {
+    public:
+        typedef ::std::vector<::std::pair<::std::string, ::std::function<void()>>> Bodies;
+    private:
+        Bodies bodies;
+        ::std::vector<::std::vector<double>> samples;
+        bool tsc = false;
+        // Time between Pause() and Resume() in the batch being timed.
+        double pause_time = 0;
+        double paused = 0;
+        unsigned long pauses = 0;
+
+        // Median ratio to the first body of each sample of body i.
+        Stats Ratio(size_t i, unsigned resamples) const {
+            ::std::vector<double> ratios;
+            for (size_t k = 0; k < samples[i].size(); ++k) {
+                if (samples[0][k] > 0) ratios.push_back(samples[i][k] / samples[0][k]);
+            }
+            Stats s;
+            Sampler::Describe(ratios, s, resamples);
+            return s;
+        }
+    public:
+        Interleave(const Bodies& bodies) :
+        bodies(bodies),
+        samples(bodies.size()) {
+        }
+
+        // Samples until there have been max rounds and policy.min_time
+        // has passed, or until policy.max_time. With policy.ci_width,
+        // stops sooner when the confidence interval of every ratio is
+        // narrower than that. Samples are warm and without counters.
+        ::std::vector<Comparison> Run(unsigned long max = 100, const Policy& policy = ::testing::policy()) {
+            const size_t n = bodies.size();
+            tsc = policy.tsc && Tsc::Available();
+            const double overhead = Sampler::Overhead(tsc);
+            // Time of the passes less pauses; wall is all of it.
+            double wall = 0;
+            auto time = [&](size_t i, unsigned long passes) {
+                auto& body = bodies[i].second;
+                paused = 0;
+                pauses = 0;
+                double start = Sampler::Read(tsc, true);
+                for (unsigned long p = 0; p < passes; ++p) body();
+                wall = Sampler::Read(tsc, false) - start;
+                double pause = paused + (pauses ? pauses * Sampler::PauseOverhead(tsc) : 0);
+                return ::std::max(0.0, wall - pause - overhead);
+            };
+            // A batch for each body long enough to time like Sampler,
+            // with paused setup counted so it doesn't inflate the batch.
+            ::std::vector<unsigned long> batch(n, 1);
+            const double target = policy.sample_time * 1e6;
+            for (size_t i = 0; i < n; ++i) {
+                for (;;) {
+                    time(i, batch[i]);
+                    double t = wall;
+                    if (t >= target || batch[i] >= (1ul << 30)) break;
+                    double grow = t > 0 ? target * 1.25 / t : 10;
+                    batch[i] = batch[i] * ::std::min(10.0, ::std::max(2.0, grow));
+                }
+            }
+            ::std::vector<size_t> order;
+            for (size_t i = 0; i < n; ++i) order.push_back(i);
+            ::std::minstd_rand rand;
+            double first = Sampler::Read(tsc, false);
+            for (unsigned long rounds = 1; ; ++rounds) {
+                ::std::shuffle(order.begin(), order.end(), rand);
+                for (auto i : order) samples[i].push_back(time(i, batch[i]) / batch[i]);
+                double elapsed = (Sampler::Read(tsc, false) - first) / 1e6;
+                if (policy.max_time > 0 && elapsed >= policy.max_time) break;
+                if (elapsed < policy.min_time || rounds < 10) continue;
+                if (rounds >= max) break;
+                if (policy.ci_width > 0 && rounds % 10 == 0) {
+                    bool converged = true;
+                    for (size_t i = 1; i < n && converged; ++i) {
+                        auto r = Ratio(i, 200);
+                        converged = r.ci_high - r.ci_low < policy.ci_width * r.median;
+                    }
+                    if (converged) break;
+                }
+            }
+            ::std::vector<Comparison> result(n);
+            for (size_t i = 0; i < n; ++i) {
+                auto& c = result[i];
+                c.name = bodies[i].first;
+                c.stats.iterations = samples[i].size();
+                c.stats.batch = batch[i];
+                Sampler::Describe(samples[i], c.stats);
+                if (tsc) c.stats.cycles = c.stats.median * Tsc::Hz() / 1e6;
+                if (i) {
+                    auto r = Ratio(i, 1000);
+                    c.ratio = r.median;
+                    c.ratio_low = r.ci_low;
+                    c.ratio_high = r.ci_high;
+                }
+            }
+            return result;
+        }
+
+        // Leave the work between them out of the body's time, as
+        // Sampler::Pause() and Resume() do.
+        void Pause() {
+            pause_time = Sampler::Read(tsc, false);
+        }
+
+        void Resume() {
+            paused += Sampler::Read(tsc, true) - pause_time;
+            ++pauses;
+        }
+
+        // Every sample of body i in microseconds, in the order taken.
+        const ::std::vector<double>& Samples(size_t i) const {
+            return samples[i];
+        }
+    };
+
+}
@@ -0,0 +1,260 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#if defined(BENCHTEST_POSIX)
+
+namespace testing {
+
+    // Messages from a forked test to the parent process. Each is
+    // buffered and written to the pipe with one write().
+    class Channel {
+        int fd;
+        ::std::string buffer;
+
+        bool Get(void* p, size_t bytes) {
+            auto c = static_cast<char*>(p);
+            while (bytes) {
+                auto n = ::read(fd, c, bytes);
+                if (n <= 0) return false;
+                c += n;
+                bytes -= n;
+            }
+            return true;
+        }
+    public:
+        enum Message : char {
+            bench = 'B',
+            threads = 'T',
+            print = 'P',
+            trace = 'R',
+            error = 'E',
+            samples = 'S',
+            compare = 'C',
+            result = 'X'
+        };
+
+        Channel(int fd) : fd(fd) {}
+
+        Channel& Put(Message m) {
+            buffer += char(m);
+            return *this;
+        }
+        Channel& Put(double d) {
+            buffer.append(reinterpret_cast<const char*>(&d), sizeof(d));
+            return *this;
+        }
+        Channel& Put(uint64_t u) {
+            buffer.append(reinterpret_cast<const char*>(&u), sizeof(u));
+            return *this;
+        }
+        Channel& Put(const ::std::string& s) {
+            Put(uint64_t(s.size()));
+            buffer += s;
+            return *this;
+        }
+
+        Channel& Put(const Stats& s) {
+            Put(uint64_t(s.iterations)).Put(uint64_t(s.batch));
+            Put(s.min).Put(s.median).Put(s.p90).Put(s.p99).Put(s.mean).Put(s.stddev);
+            Put(s.mad).Put(s.ci_low).Put(s.ci_high).Put(s.cycles).Put(s.cache);
+            Put(uint64_t(s.counters.size()));
+            for (auto& c : s.counters) Put(c.first).Put(c.second);
+            return Put(s.baseline_median).Put(s.p_value).Put(uint64_t(s.regression));
+        }
+
+        bool Send() {
+            const char* c = buffer.data();
+            size_t bytes = buffer.size();
+            while (bytes) {
+                auto n = ::write(fd, c, bytes);
+                if (n <= 0) break;
+                c += n;
+                bytes -= n;
+            }
+            buffer.clear();
+            return !bytes;
+        }
+
+        bool Get(Message& m) {
+            char c;
+            if (!Get(&c, 1)) return false;
+            m = Message(c);
+            return true;
+        }
+        bool Get(double& d) {
+            return Get(&d, sizeof(d));
+        }
+        bool Get(uint64_t& u) {
+            return Get(&u, sizeof(u));
+        }
+        bool Get(::std::string& s) {
+            uint64_t size;
+            if (!Get(size)) return false;
+            s.resize(size);
+            return !size || Get(&s[0], size);
+        }
+        bool Get(Stats& s) {
+            uint64_t u = 0, v = 0;
+            Get(u);
+            Get(v);
+            s.iterations = u;
+            s.batch = v;
+            Get(s.min);
+            Get(s.median);
+            Get(s.p90);
+            Get(s.p99);
+            Get(s.mean);
+            Get(s.stddev);
+            Get(s.mad);
+            Get(s.ci_low);
+            Get(s.ci_high);
+            Get(s.cycles);
+            Get(s.cache);
+            Get(u);
+            s.counters.resize(u);
+            for (auto& c : s.counters) {
+                Get(c.first);
+                Get(c.second);
+            }
+            Get(s.baseline_median);
+            Get(s.p_value);
+            if (!Get(u)) return false;
+            s.regression = u;
+            return true;
+        }
+    };
+
+
+    // Reporter of a forked test that sends what the parent's reporter
+    // needs over a Channel.
+    class ForkReporter : public Reporter {
+        Channel channel;
+    public:
+        ForkReporter(int fd) : channel(fd) {}
+
+        void Start(size_t, size_t) {}
+        void End(long) {}
+        void StartCase(size_t) {}
+        void EndCase(long) {}
+        void Run() {}
+        void Pass(long) {}
+        void Fail(long) {}
+        void Bench(long, double) {}
+
+        void Bench(const Stats& s) {
+            channel.Put(Channel::bench).Put(s).Send();
+        }
+
+        void Compare(const ::std::vector<Comparison>& bodies) {
+            channel.Put(Channel::compare).Put(uint64_t(bodies.size()));
+            for (auto& c : bodies) {
+                channel.Put(c.name).Put(c.stats).Put(c.ratio).Put(c.ratio_low).Put(c.ratio_high);
+            }
+            channel.Send();
+        }
+
+        void Threads(const ThreadStats& s) {
+            channel.Put(Channel::threads).Put(uint64_t(s.threads)).Put(s.seconds).Put(s.rate);
+            channel.Put(s.mean).Put(s.stddev).Put(s.min).Put(s.max).Put(s.efficiency);
+            channel.Send();
+        }
+
+        void Print(::std::string message) {
+            channel.Put(Channel::print).Put(message).Send();
+        }
+
+        void Trace(::std::string message, const char* file, long line) {
+            channel.Put(Channel::trace).Put(message).Put(file).Put(uint64_t(line)).Send();
+        }
+
+        void Error(::std::string message, const char* file, long line) {
+            channel.Put(Channel::error).Put(message).Put(file).Put(uint64_t(line)).Send();
+        }
+
+        // Samples kept for the baseline since first, and the outcome.
+        void Result(size_t first, unsigned long regressions) {
+            auto& current = baseline().Current();
+            for (size_t i = first; i < current.size(); ++i) {
+                channel.Put(Channel::samples).Put(current[i].first).Put(uint64_t(current[i].second.size()));
+                for (auto x : current[i].second) channel.Put(x);
+            }
+            channel.Put(Channel::result).Put(uint64_t(test_info->fatal_failure_count));
+            channel.Put(uint64_t(test_info->nonfatal_failure_count)).Put(uint64_t(regressions));
+            channel.Send();
+        }
+
+        // Pass the messages from a child on to reporter() until the
+        // child closes the pipe. False if it ended without a result.
+        static bool Replay(int fd) {
+            Channel channel(fd);
+            Channel::Message m;
+            bool done = false;
+            while (channel.Get(m)) {
+                ::std::string message, file;
+                uint64_t u = 0, v = 0, w = 0;
+                if (m == Channel::bench) {
+                    Stats s;
+                    if (!channel.Get(s)) break;
+                    reporter()->Bench(s);
+                } else if (m == Channel::compare) {
+                    bool ok = channel.Get(u);
+                    ::std::vector<Comparison> bodies(ok ? u : 0);
+                    for (auto& c : bodies) {
+                        ok = ok && channel.Get(c.name) && channel.Get(c.stats) &&
+                             channel.Get(c.ratio) && channel.Get(c.ratio_low) && channel.Get(c.ratio_high);
+                    }
+                    if (!ok) break;
+                    reporter()->Compare(bodies);
+                } else if (m == Channel::threads) {
+                    ThreadStats s;
+                    if (!channel.Get(u) || !channel.Get(s.seconds) || !channel.Get(s.rate) ||
+                        !channel.Get(s.mean) || !channel.Get(s.stddev) || !channel.Get(s.min) ||
+                        !channel.Get(s.max) || !channel.Get(s.efficiency)) break;
+                    s.threads = u;
+                    reporter()->Threads(s);
+                } else if (m == Channel::print) {
+                    if (!channel.Get(message)) break;
+                    reporter()->Print(message);
+                } else if (m == Channel::trace || m == Channel::error) {
+                    if (!channel.Get(message) || !channel.Get(file) || !channel.Get(u)) break;
+                    if (m == Channel::trace) reporter()->Trace(message, file.c_str(), u);
+                    else reporter()->Error(message, file.c_str(), u);
+                } else if (m == Channel::samples) {
+                    if (!channel.Get(message) || !channel.Get(u)) break;
+                    // Grown as read, so a corrupt count can't allocate much.
+                    ::std::vector<double> samples;
+                    double x;
+                    while (samples.size() < u && channel.Get(x)) samples.push_back(x);
+                    if (samples.size() < u) break;
+                    baseline().Keep(message, samples);
+                } else if (m == Channel::result) {
+                    if (!channel.Get(u) || !channel.Get(v) || !channel.Get(w)) break;
+                    reporter()->test_info->fatal_failure_count = u;
+                    reporter()->test_info->nonfatal_failure_count = v;
+                    baseline().regressions += w;
+                    done = true;
+                } else {
+                    break;
+                }
+            }
+            return done;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Compiler barriers for benchmark bodies. Results that are never
+    // used may be removed by the optimizer, and stores that are never
+    // read back may be dropped, leaving nothing to time.
+    //
+    //     while (Benchmark()) {
+    //         FFT::dft(in, out);
+    //         DoNotOptimize(out);
+    //     }
+
+#if defined(__GNUC__)
+    // The value must be computed and is assumed to be read. Values
+    // larger than a register stay in memory; offering a register would
+    // let the compiler copy them to the stack, which large arrays overflow.
+    template <typename T>
+    inline typename ::std::enable_if<(sizeof(T) <= sizeof(void*))>::type DoNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+    template <typename T>
+    inline typename ::std::enable_if<(sizeof(T) > sizeof(void*))>::type DoNotOptimize(const T& value) {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+
+    // The value must be computed and may have been changed.
+    template <typename T>
+    inline typename ::std::enable_if<(sizeof(T) <= sizeof(void*))>::type DoNotOptimize(T& value) {
+        asm volatile("" : "+r,m"(value) : : "memory");
+    }
+    template <typename T>
+    inline typename ::std::enable_if<(sizeof(T) > sizeof(void*))>::type DoNotOptimize(T& value) {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+
+    // All pending stores to memory must be done.
+    inline void ClobberMemory() {
+        asm volatile("" : : : "memory");
+    }
+#else
+    template <typename T>
+    inline void DoNotOptimize(const T& value) {
+        static const volatile void* sink;
+        sink = &value;
+        ::std::atomic_signal_fence(::std::memory_order_seq_cst);
+    }
+
+    inline void ClobberMemory() {
+        ::std::atomic_signal_fence(::std::memory_order_seq_cst);
+    }
+#endif
+
+}
@@ -29,6 +29,23 @@ namespace testing {
         virtual void Pass(long ms) = 0;
         virtual void Fail(long ms) = 0;
         virtual void Bench(long iterations, double us) = 0;
+        // Reporters written for the hook above keep working: the richer
+        // results are forwarded to it, or printed, unless overridden.
+        virtual void Bench(const Stats& stats) {
+            Bench(stats.iterations, stats.median);
+        }
+        virtual void Threads(const ThreadStats& stats) {
+            ::std::ostringstream s;
+            s << "[ THREADS  ] " << stats.threads << " threads, " << stats.rate << " calls/s";
+            Print(s.str());
+        }
+        virtual void Compare(const ::std::vector<Comparison>& bodies) {
+            for (auto& c : bodies) {
+                ::std::ostringstream s;
+                s << "[ COMPARE  ] " << c.name << " " << c.stats.median << " us, " << c.ratio << "x";
+                Print(s.str());
+            }
+        }
         virtual void Print(::std::string message) = 0;
         virtual void Trace(::std::string message, const char* file, long line) = 0;
         virtual void Error(::std::string message, const char* file, long line) = 0;
@@ -46,6 +63,17 @@ namespace testing {
         size_t total_qty;
         size_t case_qty;
         ::std::vector<::std::string> failures;
+        ::std::vector<::std::string> regressions;
+        struct Timing {
+            ::std::string name;
+            size_t size;
+            double us;
+            double cycles;
+        };
+        ::std::vector<Timing> timings;
+        // Last warm median, to compare with a cold run of the same test.
+        Info* warm_info = nullptr;
+        double warm_us = 0;
 
         virtual ::std::string Pluralize(size_t qty, const char* label = nullptr) {
             auto str = ::std::to_string(qty);
@@ -63,11 +91,38 @@ namespace testing {
             this->cases = cases;
             this->total_qty = total_qty;
             failures.clear();
+            regressions.clear();
             *ostream << "[==========] Running " << Pluralize(total_qty) << " from ";
             *ostream << Pluralize(cases, "test case") << "." << ::std::endl;
         }
 
+        // Benchmarks of TEST_P instances with flops for a radix-2 FFT,
+        // 5 N log2(N), to compare across sizes.
+        virtual void Table() {
+            auto flags = ostream->flags();
+            auto precision = ostream->precision();
+            *ostream << "[----------] " << Pluralize(timings.size(), "benchmark") << " by size" << ::std::endl;
+            *ostream << "[          ] " << ::std::setw(8) << "N" << ::std::setw(12) << "median us";
+            *ostream << ::std::setw(10) << "ns/pt" << ::std::setw(10) << "cycles/pt";
+            *ostream << ::std::setw(10) << "GFLOPS" << "  test" << ::std::endl;
+            *ostream << ::std::fixed;
+            for (auto& t : timings) {
+                double n = t.size;
+                *ostream << "[          ] " << ::std::setw(8) << t.size;
+                *ostream << ::std::setprecision(2) << ::std::setw(12) << t.us;
+                *ostream << ::std::setw(10) << t.us * 1000 / n;
+                if (t.cycles) *ostream << ::std::setw(10) << t.cycles / n;
+                else *ostream << ::std::setw(10) << "-";
+                *ostream << ::std::setw(10) << 5 * n * ::std::log2(n) / (t.us * 1000);
+                *ostream << "  " << t.name << ::std::endl;
+            }
+            ostream->flags(flags);
+            ostream->precision(precision);
+            *ostream << ::std::endl;
+        }
+
         virtual void End(long ms) {
+            if (!timings.empty()) Table();
             *ostream << "[==========] " << Pluralize(total_qty) << " from ";
             *ostream << Pluralize(cases, "test case") << " ran. ";
             *ostream << "(" << ms << " ms total)" << ::std::endl;
@@ -79,6 +134,13 @@ namespace testing {
                 }
                 *ostream << ::std::endl << " " << Pluralize(failures.size(), "FAILED TEST") << ::std::endl;
             }
+            if (!regressions.empty()) {
+                *ostream << "[REGRESSION] " << Pluralize(regressions.size(), "benchmark");
+                *ostream << " slower than the baseline, listed below:" << ::std::endl;
+                for (auto r : regressions) {
+                    *ostream << "[REGRESSION] " << r << ::std::endl;
+                }
+            }
         }
 
         virtual void StartCase(size_t case_qty) {
@@ -109,6 +171,87 @@ namespace testing {
             *ostream << "[   TIME   ] " << iterations << " iterations, " << us << " us" << ::std::endl;
         }
 
+        virtual void Bench(const Stats& stats) {
+            *ostream << "[   TIME   ] ";
+            if (!stats.cache.empty()) *ostream << stats.cache << ", ";
+            *ostream << stats.iterations;
+            if (stats.batch > 1) *ostream << " x " << stats.batch;
+            *ostream << " iterations, " << stats.median << " us";
+            *ostream << " (" << stats.ci_low << "-" << stats.ci_high << " us 95% CI)";
+            if (stats.cycles) {
+                *ostream << ", " << stats.cycles << " cycles";
+                if (test_info->size) *ostream << ", " << stats.cycles / test_info->size << " cycles/pt";
+            }
+            *ostream << ::std::endl;
+            *ostream << "[          ] min " << stats.min << ", p90 " << stats.p90 << ", p99 " << stats.p99;
+            *ostream << ", stddev " << stats.stddev << ", MAD " << stats.mad << " us" << ::std::endl;
+            if (!stats.counters.empty()) {
+                double instructions = 0, cycles = 0;
+                const char* separator = " per iteration: ";
+                *ostream << "[          ]";
+                for (auto& c : stats.counters) {
+                    *ostream << separator << c.first << " " << c.second;
+                    separator = ", ";
+                    if (c.first == "instructions") instructions = c.second;
+                    if (c.first == "cycles") cycles = c.second;
+                }
+                if (instructions && cycles) *ostream << ", IPC " << instructions / cycles;
+                *ostream << ::std::endl;
+            }
+            if (stats.baseline_median) {
+                auto name = test_info->name();
+                if (!stats.cache.empty()) name += " " + stats.cache;
+                Versus(name, stats);
+            }
+            if (stats.cache == "warm") {
+                warm_info = test_info;
+                warm_us = stats.median;
+            }
+            if (stats.cache == "cold" && warm_info == test_info && warm_us > 0) {
+                *ostream << "[          ] cold " << stats.median << " us vs warm " << warm_us;
+                *ostream << " us, " << stats.median / warm_us << "x" << ::std::endl;
+            }
+            if (test_info->size) {
+                auto name = test_info->name();
+                if (!stats.cache.empty()) name += " " + stats.cache;
+                timings.push_back(Timing{name, test_info->size, stats.median, stats.cycles});
+            }
+        }
+
+        // Comparison with the baseline.
+        virtual void Versus(const ::std::string& name, const Stats& stats) {
+            if (stats.regression) regressions.push_back(name);
+            auto change = ::std::round((stats.median / stats.baseline_median - 1) * 1000) / 10;
+            *ostream << (stats.regression ? "[REGRESSION] " : "[          ] ");
+            *ostream << "baseline " << stats.baseline_median << " us, ";
+            *ostream << (change > 0 ? "+" : "") << change << "%, p " << stats.p_value << ::std::endl;
+        }
+
+        virtual void Compare(const ::std::vector<Comparison>& bodies) {
+            if (bodies.empty()) return;
+            *ostream << "[ COMPARE  ] " << bodies.size() << " interleaved, ";
+            *ostream << Pluralize(bodies[0].stats.iterations, "round") << ::std::endl;
+            for (auto& c : bodies) {
+                auto& s = c.stats;
+                *ostream << "[          ] " << c.name << " " << s.median << " us";
+                *ostream << " (" << s.ci_low << "-" << s.ci_high << " us 95% CI)";
+                if (&c != &bodies[0]) {
+                    *ostream << ", " << c.ratio << "x " << bodies[0].name;
+                    *ostream << " (" << c.ratio_low << "-" << c.ratio_high << " 95% CI)";
+                }
+                *ostream << ::std::endl;
+                if (s.baseline_median) Versus(test_info->name() + " " + c.name, s);
+            }
+        }
+
+        virtual void Threads(const ThreadStats& stats) {
+            *ostream << "[ THREADS  ] " << Pluralize(stats.threads, "thread") << ", " << stats.rate << " calls/s";
+            if (stats.efficiency) *ostream << ", " << stats.efficiency * 100 << "% of linear";
+            *ostream << ::std::endl;
+            *ostream << "[          ] per thread " << stats.mean << " calls/s, stddev " << stats.stddev;
+            *ostream << ", min " << stats.min << ", max " << stats.max << ::std::endl;
+        }
+
         virtual void Print(::std::string message) {
             *ostream << message << ::std::endl;
         }
@@ -17,7 +17,6 @@
 namespace testing {
 
     //TODO validate all cases really use same fixture
-    //TODO add argv options
     
     class Runner {
         
@@ -27,67 +26,305 @@ namespace testing {
             return ::std::chrono::duration<double, ::std::milli>(end_time - start_time).count();
         }
         
-        static ::std::map<::std::string, ::std::list<class Info*>>& testers() {
-            static ::std::map<::std::string, ::std::list<class Info*>> testers;
+        // Test cases in the order they were first registered.
+        static ::std::vector<::std::pair<::std::string, ::std::list<class Info*>>>& testers() {
+            static ::std::vector<::std::pair<::std::string, ::std::list<class Info*>>> testers;
             return testers;
         }
 
+        static void RunTest(Info* test_info) {
+            auto test = test_info->CreateFixture();
+            test->SetUp();
+            if (!test_info->HasFatalFailure()) test->TestBody();
+            test->TearDown();
+        }
+
+        // Run a test in a child process, which starts with none of the
+        // heap, cache or static state the tests before it left behind
+        // except what it inherits. The child is pinned to cpu if not
+        // negative and spins for warmup seconds before the test so the
+        // processor leaves its idle clock.
+        static void RunForked(Info* test_info, int cpu, double warmup) {
+#if !defined(BENCHTEST_POSIX)
+            (void)cpu;
+            (void)warmup;
+            reporter()->Print("Unable to fork on this system; running in process.");
+            RunTest(test_info);
+#else
+            int fds[2];
+            if (::pipe(fds) != 0) {
+                reporter()->Print("Unable to create a pipe; running in process.");
+                return RunTest(test_info);
+            }
+            ::std::cout.flush();
+            ::std::cerr.flush();
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                ::close(fds[0]);
+                size_t first = baseline().Current().size();
+                unsigned long regressions = baseline().regressions;
+                auto child = new ForkReporter(fds[1]);
+                child->test_info = test_info;
+                reporter(child);
+                bool pinned = cpu < 0;
+#ifdef __linux__
+                if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(cpu, &set);
+                    pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+                }
+#endif
+                if (!pinned) {
+                    reporter()->Print("Unable to pin the test process to CPU " + ::std::to_string(cpu) + ".");
+                    ++test_info->fatal_failure_count;
+                } else {
+                    auto end = ::std::chrono::steady_clock::now() + ::std::chrono::duration<double>(warmup);
+                    while (::std::chrono::steady_clock::now() < end) {}
+                    RunTest(test_info);
+                }
+                child->Result(first, baseline().regressions - regressions);
+                ::std::cout.flush();
+                ::std::cerr.flush();
+                ::_exit(0);
+            }
+            ::close(fds[1]);
+            bool done = pid > 0 && ForkReporter::Replay(fds[0]);
+            ::close(fds[0]);
+            int status = 0;
+            if (pid > 0) ::waitpid(pid, &status, 0);
+            if (!done) {
+                ::std::string s = "Test process ";
+                if (pid < 0) s += "could not be created.";
+                else if (WIFSIGNALED(status)) s += "killed by signal " + ::std::to_string(WTERMSIG(status)) + ".";
+                else s += "exited with status " + ::std::to_string(WEXITSTATUS(status)) + ".";
+                reporter()->Print(s);
+                ++test_info->fatal_failure_count;
+            }
+#endif
+        }
+
+        static void Usage(const char* program) {
+            ::std::cout << "Usage: " << program << " [options]" << ::std::endl
+            << "  --filter=POSITIVE[-NEGATIVE]  Run tests matching the ':' separated globs." << ::std::endl
+            << "  --repeat=N                    Run the selected tests N times." << ::std::endl
+            << "  --benchmark_min_time=SECONDS  Sample each benchmark for at least this long." << ::std::endl
+            << "  --format=text|json|csv        Results format, also BENCHTEST_FORMAT." << ::std::endl
+            << "  --list                        List the selected tests without running them." << ::std::endl
+            << "  --no-bench                    Run benchmark bodies once for correctness only." << ::std::endl
+            << "  --baseline=FILE               Compare with a baseline, also BENCHTEST_BASELINE." << ::std::endl
+            << "  --save_baseline=FILE          Save a baseline, also BENCHTEST_SAVE_BASELINE." << ::std::endl
+            << "  --threshold=FRACTION          Slowdown that is a regression, also BENCHTEST_THRESHOLD." << ::std::endl
+            << "  --fork                        Run each test in a new child process." << ::std::endl
+            << "  --pin=CPU                     Pin each --fork child to this CPU." << ::std::endl
+            << "  --warmup=SECONDS              Spin in each --fork child before the test." << ::std::endl;
+        }
+
+        // All of s as a non-negative number. Empty strings, signs,
+        // trailing text and values out of range are rejected, leaving
+        // the result unchanged.
+        static bool Parse(const char* s, double& d) {
+            char* end;
+            errno = 0;
+            double v = ::std::strtod(s, &end);
+            if (!*s || *end || errno || !::std::isfinite(v) || v < 0) return false;
+            d = v;
+            return true;
+        }
+
+        static bool Parse(const char* s, unsigned long& u) {
+            char* end;
+            errno = 0;
+            unsigned long v = ::std::strtoul(s, &end, 10);
+            if (*s < '0' || *s > '9' || *end || errno) return false;
+            u = v;
+            return true;
+        }
+
+        static bool Parse(const char* s, int& i) {
+            unsigned long u;
+            if (!Parse(s, u) || u > INT_MAX) return false;
+            i = int(u);
+            return true;
+        }
+
     public:
         
+        // Glob match with * and ?.
+        static bool Match(const char* pattern, const char* name) {
+            if (*pattern == '*') {
+                return Match(pattern + 1, name) || (*name && Match(pattern, name + 1));
+            }
+            if (!*pattern) return !*name;
+            return *name && (*pattern == '?' || *pattern == *name) && Match(pattern + 1, name + 1);
+        }
+
+        // gtest style filter, POSITIVE[-NEGATIVE], where each part is
+        // a list of globs separated by ':'.
+        static bool Filter(const ::std::string& filter, const ::std::string& name) {
+            auto dash = filter.find('-');
+            auto any = [&name](::std::string globs) {
+                ::std::istringstream s(globs);
+                ::std::string glob;
+                while (::std::getline(s, glob, ':')) {
+                    if (Match(glob.c_str(), name.c_str())) return true;
+                }
+                return false;
+            };
+            auto positive = filter.substr(0, dash);
+            if (positive.empty()) positive = "*";
+            if (!any(positive)) return false;
+            return dash == ::std::string::npos || !any(filter.substr(dash + 1));
+        }
+
         static void AddTest(Info* tester) {
-            testers()[tester->test_case_name()].push_back(tester);
+            auto name = tester->test_case_name();
+            for (auto& x : testers()) {
+                if (x.first == name) {
+                    x.second.push_back(tester);
+                    return;
+                }
+            }
+            testers().push_back(::std::make_pair(name, ::std::list<class Info*>(1, tester)));
         }
 
 #if defined(__GNUC__) && !defined(COMPILER_ICC)
         __attribute__ ((warn_unused_result))
 #endif
-        static int RunAll()
+        static int RunAll(int argc = 0, char** argv = nullptr)
         {
             auto total_start = ::std::chrono::high_resolution_clock::now();
             bool has_failures = false;
+            // Options from the environment, overridden by the command line.
+            ::std::string filter = "*";
+            unsigned long repeat = 1;
+            bool list = false;
+            bool fork = false;
+            int cpu = -1;
+            double warmup = 0;
+            const char* format = nullptr;
+            const char* load_path = ::std::getenv("BENCHTEST_BASELINE");
+            const char* save_path = ::std::getenv("BENCHTEST_SAVE_BASELINE");
+            const char* threshold = ::std::getenv("BENCHTEST_THRESHOLD");
+            for (int i = 1; i < argc; ++i) {
+                ::std::string arg = argv[i];
+                auto eq = arg.find('=');
+                auto option = arg.substr(0, eq);
+                const char* value = eq == ::std::string::npos ? nullptr : argv[i] + eq + 1;
+                bool valid = true;
+                if (option == "--list" && !value) list = true;
+                else if (option == "--no-bench" && !value) policy().dry_run = true;
+                else if (option == "--filter" && value) filter = value;
+                else if (option == "--repeat" && value) valid = Parse(value, repeat) && repeat > 0;
+                else if (option == "--benchmark_min_time" && value) valid = Parse(value, policy().min_time);
+                else if (option == "--format" && value) format = value;
+                else if (option == "--baseline" && value) load_path = value;
+                else if (option == "--save_baseline" && value) save_path = value;
+                else if (option == "--threshold" && value) threshold = value;
+                else if (option == "--fork" && !value) fork = true;
+                else if (option == "--pin" && value) valid = Parse(value, cpu);
+                else if (option == "--warmup" && value) valid = Parse(value, warmup);
+                else {
+                    if (option != "--help") ::std::cerr << "Unknown option " << arg << ::std::endl;
+                    Usage(argv[0]);
+                    return option == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+                }
+                if (!valid) {
+                    ::std::cerr << "Invalid value in " << arg << ::std::endl;
+                    Usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+            }
+            double slowdown = 0;
+            if (threshold && !Parse(threshold, slowdown)) {
+                ::std::cerr << "Invalid threshold " << threshold << ::std::endl;
+                Usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            if (format) reporter(NewReporter(format));
+
+            // Test cases with at least one test selected by the filter.
+            ::std::vector<::std::pair<::std::string, ::std::list<class Info*>>> selected;
             size_t numtests = 0;
             for (auto& x : testers()) {
-                numtests += x.second.size();
+                ::std::list<class Info*> tests;
+                for (auto test_info : x.second) {
+                    if (Filter(filter, test_info->name())) tests.push_back(test_info);
+                }
+                numtests += tests.size();
+                if (!tests.empty()) selected.push_back(::std::make_pair(x.first, tests));
             }
-            reporter()->Start(testers().size(), numtests);
-            for (auto& tester : testers()) {
-                auto case_start = ::std::chrono::high_resolution_clock::now();
-                reporter()->test_info = tester.second.front();
-                reporter()->StartCase(tester.second.size());
-                reporter()->test_info->SetUpTestCase();
-                has_failures = has_failures || reporter()->test_info->HasFailure();
-                bool set_up_case_fatal_failure = reporter()->test_info->HasFatalFailure();
-                if (set_up_case_fatal_failure) {
-                    ::std::string s("Fatal failure in ");
-                    s += tester.first;
-                    s += "::SetUpTestCase(); not running tests.";
-                    reporter()->Print(s);
+            if (list) {
+                for (auto& tester : selected) {
+                    ::std::cout << tester.first << "." << ::std::endl;
+                    for (auto test_info : tester.second) {
+                        ::std::cout << "  " << test_info->test_base_name() << ::std::endl;
+                    }
+                }
+                return EXIT_SUCCESS;
+            }
+
+            // Compare with a baseline and save this run as one. The
+            // threshold is the slowdown that counts as a regression.
+            auto& base = baseline();
+            if (threshold) base.threshold = slowdown;
+            reporter()->Start(selected.size() * repeat, numtests * repeat);
+            if (load_path && !base.Load(load_path)) {
+                reporter()->Print(::std::string("Unable to load baseline ") + load_path);
+                has_failures = true;
+            }
+            for (unsigned long iteration = 1; iteration <= repeat; ++iteration) {
+                if (repeat > 1) {
+                    reporter()->Print("Repeating all tests (iteration " + ::std::to_string(iteration) + ") . . .\n");
                 }
-                for (auto& test_info : tester.second) {
-                    auto test_start = ::std::chrono::high_resolution_clock::now();
-                    reporter()->test_info = test_info;
+                // Each repetition reports only its own failures.
+                for (auto& tester : selected) {
+                    for (auto test_info : tester.second) {
+                        test_info->fatal_failure_count = 0;
+                        test_info->nonfatal_failure_count = 0;
+                    }
+                }
+                for (auto& tester : selected) {
+                    auto case_start = ::std::chrono::high_resolution_clock::now();
+                    reporter()->test_info = tester.second.front();
+                    reporter()->StartCase(tester.second.size());
+                    reporter()->test_info->SetUpTestCase();
+                    has_failures = has_failures || reporter()->test_info->HasFailure();
+                    bool set_up_case_fatal_failure = reporter()->test_info->HasFatalFailure();
                     if (set_up_case_fatal_failure) {
-                        reporter()->Fail(RunTime(test_start));
-                    } else {
-                        reporter()->Run();
-                        auto test = test_info->CreateFixture();
-                        test->SetUp();
-                        if (!reporter()->test_info->HasFatalFailure()) test->TestBody();
-                        test->TearDown();
-                        if (reporter()->test_info->HasFailure()) {
-                            has_failures = true;
+                        ::std::string s("Fatal failure in ");
+                        s += tester.first;
+                        s += "::SetUpTestCase(); not running tests.";
+                        reporter()->Print(s);
+                    }
+                    for (auto& test_info : tester.second) {
+                        auto test_start = ::std::chrono::high_resolution_clock::now();
+                        reporter()->test_info = test_info;
+                        if (set_up_case_fatal_failure) {
                             reporter()->Fail(RunTime(test_start));
                         } else {
-                            reporter()->Pass(RunTime(test_start));
+                            reporter()->Run();
+                            if (fork) RunForked(test_info, cpu, warmup);
+                            else RunTest(test_info);
+                            if (reporter()->test_info->HasFailure()) {
+                                has_failures = true;
+                                reporter()->Fail(RunTime(test_start));
+                            } else {
+                                reporter()->Pass(RunTime(test_start));
+                            }
                         }
                     }
+                    reporter()->test_info->TearDownTestCase();
+                    has_failures = has_failures || reporter()->test_info->HasFailure();
+                    reporter()->EndCase(RunTime(case_start));
                 }
-                reporter()->test_info->TearDownTestCase();
-                has_failures = has_failures || reporter()->test_info->HasFailure();
-                reporter()->EndCase(RunTime(case_start));
+            }
+            if (save_path && !base.Save(save_path)) {
+                reporter()->Print(::std::string("Unable to save baseline ") + save_path);
+                has_failures = true;
             }
             reporter()->End(RunTime(total_start));
-            if (has_failures) return EXIT_FAILURE;
+            if (has_failures || base.regressions) return EXIT_FAILURE;
             return EXIT_SUCCESS;
         }
         
@@ -106,11 +343,90 @@ namespace testing {
             C::TearDownTestCase();
         }
     public:
-        Factory(const char* test_case_name, const char* test_name, const char* type_name) :
-        Info(test_case_name, test_name, type_name) {
+        Factory(const char* test_case_name, const char* test_name, const char* type_name, size_t size = 0) :
+        Info(test_case_name, test_name, type_name, size) {
             Runner::AddTest(this);
         }
     };
 
+
+    // Registers the TEST_P class C<T, N> for N = First, 2*First ... Last.
+    template <template <typename, size_t> class C, typename T, size_t First, size_t Last,
+              bool = (First < Last)>
+    struct Sizes {
+        Sizes(const char* test_case_name, const char* test_name, const char* type_name) {
+            C<T, First>::test_info = new Factory<C<T, First>>(test_case_name, test_name, type_name, First);
+            Sizes<C, T, First * 2, Last>(test_case_name, test_name, type_name);
+        }
+    };
+
+    template <template <typename, size_t> class C, typename T, size_t First, size_t Last>
+    struct Sizes<C, T, First, Last, false> {
+        Sizes(const char* test_case_name, const char* test_name, const char* type_name) {
+            C<T, First>::test_info = new Factory<C<T, First>>(test_case_name, test_name, type_name, First);
+        }
+    };
+
+    // TEST_P methods of fixture F, by the __COUNTER__ value at each
+    // TEST_P. Values used for anything else are left undeclared.
+    template <template <typename, size_t> class F, int I>
+    struct ParamTest {
+        static const bool declared = false;
+    };
+
+    // Registers the TEST_P at counter value I, if any, for T and every size.
+    template <template <typename, size_t> class F, typename T, size_t First, size_t Last, int I,
+              bool = ParamTest<F, I>::declared>
+    struct ParamMethod {
+        static void Add(const char* test_case_name, const char* type_name) {
+            Sizes<ParamTest<F, I>::template Test, T, First, Last>(test_case_name, ParamTest<F, I>::Name(), type_name);
+        }
+    };
+
+    template <template <typename, size_t> class F, typename T, size_t First, size_t Last, int I>
+    struct ParamMethod<F, T, First, Last, I, false> {
+        static void Add(const char*, const char*) {
+        }
+    };
+
+    // Registers every TEST_P of F with a counter value from I up to End.
+    template <template <typename, size_t> class F, typename T, size_t First, size_t Last, int I, int End,
+              bool = (I < End)>
+    struct ParamMethods {
+        static void Add(const char* test_case_name, const char* type_name) {
+            ParamMethod<F, T, First, Last, I>::Add(test_case_name, type_name);
+            ParamMethods<F, T, First, Last, I + 1, End>::Add(test_case_name, type_name);
+        }
+    };
+
+    template <template <typename, size_t> class F, typename T, size_t First, size_t Last, int I, int End>
+    struct ParamMethods<F, T, First, Last, I, End, false> {
+        static void Add(const char*, const char*) {
+        }
+    };
+
+    // Registers every TEST_P of F declared before counter value End for
+    // each of the types Ts and every size. type_names is the types as
+    // written, separated by commas.
+    template <template <typename, size_t> class F, size_t First, size_t Last, int End, typename... Ts>
+    struct Instantiation {
+        Instantiation(const char* test_case_name, const char* type_names) {
+            // Info keeps the names, so they must outlive registration.
+            static ::std::list<::std::string> names;
+            ::std::vector<const char*> types;
+            ::std::istringstream in(type_names);
+            ::std::string name;
+            while (::std::getline(in, name, ',')) {
+                name.erase(0, name.find_first_not_of(' '));
+                name.erase(name.find_last_not_of(' ') + 1);
+                names.push_back(name);
+                types.push_back(names.back().c_str());
+            }
+            size_t i = 0;
+            int expand[] = {0, (ParamMethods<F, Ts, First, Last, 0, End>::Add(test_case_name, types.at(i++)), 0)...};
+            (void)expand;
+        }
+    };
+
     
 }
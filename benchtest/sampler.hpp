@@ -0,0 +1,417 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Summary of the samples from one benchmark, in microseconds.
+    struct Stats {
+        unsigned long iterations = 0;
+        double min = 0;
+        double median = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double mean = 0;
+        double stddev = 0;
+        // Median absolute deviation from the median.
+        double mad = 0;
+        // 95% bootstrap confidence interval of the median.
+        double ci_low = 0;
+        double ci_high = 0;
+        // Calls timed together in each sample.
+        unsigned long batch = 1;
+        // Median TSC cycles per call when timed with the TSC, otherwise 0.
+        double cycles = 0;
+        // "warm" or "cold" when the policy asked for either, else empty.
+        ::std::string cache;
+        // Mean count of each available event per call, if counted.
+        ::std::vector<::std::pair<::std::string, double>> counters;
+        // Median of the same benchmark in the baseline, or 0 if none.
+        double baseline_median = 0;
+        // One-sided Mann-Whitney p-value that this run is slower.
+        double p_value = 1;
+        // Slower than the baseline by more than the threshold and significant.
+        bool regression = false;
+    };
+
+    // When a benchmark stops sampling. The global default is policy();
+    // a Test may change its own copy before calling Benchmark().
+    // With the time fields zero, sampling stops after the max samples
+    // given to Next() or once a sample is no longer among the fastest.
+    struct Policy {
+        // Each sample times a batch of enough passes to last at least
+        // this many seconds, so the clock is a small part of it.
+        double sample_time = 10e-6;
+        // Time with the TSC when Tsc::Available(), else the system clock.
+        bool tsc = true;
+        // Count events such as cache misses with Counters. Reading them
+        // happens outside the timed part of each sample.
+        bool counters = false;
+        // Whether data starts in cache. Cold samples are single passes
+        // with caches flushed before the pass and at each Resume(). Both
+        // runs a Test's benchmark warm and then cold.
+        enum Cache {
+            warm,
+            cold,
+            both
+        };
+        Cache cache = warm;
+        // Keep sampling for at least this many seconds.
+        double min_time = 0;
+        // Never sample for longer than this many seconds, if not zero.
+        double max_time = 0;
+        // If not zero, stop when the 95% confidence interval of the
+        // median is narrower than this fraction of the median, instead
+        // of waiting for the fastest samples to settle.
+        double ci_width = 0;
+        // Run the body of Benchmark() once, untimed and unreported, to
+        // check results without benchmarking.
+        bool dry_run = false;
+    };
+
+    template<bool=true>
+    Policy& policy() {
+        static Policy p;
+        return p;
+    }
+
+    // Times each pass of a loop and keeps every sample. Passes faster
+    // than Policy::sample_time are timed in batches and each sample is
+    // the time of one pass, less the overhead of reading the clock.
+    // Usable outside of a Test, for example to pick the fastest kernel:
+    //
+    //     Sampler s;
+    //     while (s.Next()) kernel(data);
+    //     double us = s.Mean();
+    class Sampler {
+        friend class Interleave;
+        double start_time = 0;
+        double first_time = 0;
+        ::std::vector<double> samples;
+        // Max-heap of the fastest samples, which decides when to stop.
+        ::std::vector<double> fastest;
+        unsigned long count = 0;
+        unsigned long size = 0;
+        unsigned long batch = 1;
+        unsigned long pending = 0;
+        bool calibrating = true;
+        bool keep_running = true;
+        bool settled = false;
+        bool tsc = false;
+        bool cold = false;
+        ::std::string cache;
+        // Memory flushed before cold passes; all caches when empty.
+        ::std::vector<::std::pair<const void*, size_t>> regions;
+
+        void Evict() {
+            bool flushed = !regions.empty();
+            for (auto& r : regions) flushed = Cache::Flush(r.first, r.second) && flushed;
+            if (!flushed) Cache::Evict();
+        }
+        // Event counts for the samples so far, when counting.
+        ::std::shared_ptr<Counters> counters;
+        ::std::vector<uint64_t> begin_counts, end_counts;
+        ::std::vector<double> counts;
+        unsigned long counted = 0;
+        // Time and events between Pause() and Resume() in this sample.
+        double pause_time = 0;
+        double paused = 0;
+        unsigned long pauses = 0;
+        ::std::vector<uint64_t> pause_counts, resume_counts, paused_counts;
+
+        void Start() {
+            paused = 0;
+            pauses = 0;
+            if (cold && keep_running) Evict();
+            if (counters) {
+                counters->Read(begin_counts);
+                paused_counts.assign(begin_counts.size(), 0);
+            }
+            start_time = Read(tsc, true);
+        }
+
+        // Microseconds on the TSC or the system clock. The TSC is read
+        // with a fence on the side of the timed code.
+        static double Read(bool tsc, bool start) {
+            if (tsc) {
+                static const double us = 1e6 / Tsc::Hz();
+                return (start ? Tsc::Start() : Tsc::Stop()) * us;
+            }
+            auto now = ::std::chrono::high_resolution_clock::now().time_since_epoch();
+            return ::std::chrono::duration<double, std::micro>(now).count();
+        }
+
+        // Microseconds between two back to back clock reads.
+        static double Measure(bool tsc) {
+            double best = 1e9;
+            for (int i = 0; i < 1000; ++i) {
+                double t0 = Read(tsc, true);
+                double t1 = Read(tsc, false);
+                best = ::std::min(best, t1 - t0);
+            }
+            return best;
+        }
+
+        static double Overhead(bool tsc) {
+            static const double system = Measure(false);
+            if (!tsc) return system;
+            static const double counter = Measure(true);
+            return counter;
+        }
+
+        // Microseconds a Pause() and Resume() add to a sample.
+        static double PauseOverhead(bool tsc) {
+            auto measure = [](bool tsc) {
+                Sampler scratch;
+                scratch.tsc = tsc;
+                double best = 1e9;
+                for (int i = 0; i < 1000; ++i) {
+                    scratch.paused = 0;
+                    double t0 = Read(tsc, true);
+                    scratch.Pause();
+                    scratch.Resume();
+                    double t1 = Read(tsc, false);
+                    best = ::std::min(best, t1 - t0 - scratch.paused);
+                }
+                return ::std::max(0.0, best - Overhead(tsc));
+            };
+            static const double system = measure(false);
+            if (!tsc) return system;
+            static const double counter = measure(true);
+            return counter;
+        }
+
+        static const Policy& Defaults() {
+            static const Policy p;
+            return p;
+        }
+
+        // Order statistic confidence interval of the median; cheaper
+        // than the bootstrap in Statistics() so it can run while sampling.
+        bool Converged(double width) const {
+            if (samples.size() < 10) return false;
+            auto sorted = samples;
+            ::std::sort(sorted.begin(), sorted.end());
+            double n = sorted.size();
+            double half = 0.98 * ::std::sqrt(n);
+            size_t lo = ::std::max(0.0, ::std::floor(n / 2 - half));
+            size_t hi = ::std::min(n - 1, ::std::ceil(n / 2 + half));
+            double median = Quantile(sorted, 0.5);
+            return median > 0 && (sorted[hi] - sorted[lo]) < width * median;
+        }
+
+        // Value at fraction q of sorted, by linear interpolation.
+        static double Quantile(const ::std::vector<double>& sorted, double q) {
+            double pos = q * (sorted.size() - 1);
+            size_t i = pos;
+            if (i + 1 >= sorted.size()) return sorted.back();
+            return sorted[i] + (pos - i) * (sorted[i + 1] - sorted[i]);
+        }
+
+        static double Median(::std::vector<double> v) {
+            ::std::sort(v.begin(), v.end());
+            return Quantile(v, 0.5);
+        }
+
+    public:
+        // Call once before each pass. Returns false when done.
+        bool Next(unsigned long max = 100) {
+            return Next(max, Defaults());
+        }
+
+        bool Next(unsigned long max, const Policy& policy) {
+            if (pending > 1) {
+                --pending;
+                return true;
+            }
+            if (!size) {
+                tsc = policy.tsc && Tsc::Available();
+                cold = policy.cache == Policy::cold;
+                if (policy.cache != Policy::warm) cache = cold ? "cold" : "warm";
+                if (cold) calibrating = false;
+            }
+            double end_time = Read(tsc, false);
+            double this_time = end_time - start_time - paused;
+            if (pauses) this_time -= pauses * PauseOverhead(tsc);
+            if (counters) counters->Read(end_counts);
+            if (!keep_running) return false;
+            if (!size) {
+                size = max / 5;
+                if (size < 10) size = 10;
+                first_time = end_time;
+                Overhead(tsc);
+                if (policy.counters) {
+                    counters = ::std::make_shared<Counters>();
+                    counts.assign(3 * counters->Names().size(), 0);
+                }
+            }
+            if (count && calibrating) {
+                // Grow the batch until it takes sample_time, discarding
+                // the short samples. Aim past the target by a quarter.
+                // Paused time counts here, or a body that is mostly setup
+                // would grow the batch far past the target.
+                double target = policy.sample_time * 1e6;
+                double wall = end_time - start_time;
+                bool expired = policy.max_time > 0 && (end_time - first_time) / 1e6 >= policy.max_time;
+                if (wall < target && !expired && batch < (1ul << 30)) {
+                    double grow = wall > 0 ? target * 1.25 / wall : 10;
+                    batch = batch * ::std::min(10.0, ::std::max(2.0, grow));
+                    pending = batch;
+                    Start();
+                    return true;
+                }
+                calibrating = false;
+            }
+            if (count) {
+                this_time = ::std::max(0.0, this_time - Overhead(tsc)) / batch;
+                samples.push_back(this_time);
+                for (size_t i = 0; i < counts.size(); ++i) {
+                    counts[i] += end_counts[i] - begin_counts[i] - paused_counts[i];
+                }
+                counted += batch;
+                if (fastest.size() < size) {
+                    fastest.push_back(this_time);
+                    ::std::push_heap(fastest.begin(), fastest.end());
+                    settled = false;
+                } else if (this_time < fastest.front()) {
+                    ::std::pop_heap(fastest.begin(), fastest.end());
+                    fastest.back() = this_time;
+                    ::std::push_heap(fastest.begin(), fastest.end());
+                    settled = false;
+                } else {
+                    settled = true;
+                }
+            }
+            ++count;
+            double elapsed = (end_time - first_time) / 1e6;
+            if (policy.max_time > 0 && elapsed >= policy.max_time) {
+                keep_running = false;
+            } else if (elapsed >= policy.min_time) {
+                if (count > max) keep_running = false;
+                else if (policy.ci_width > 0) {
+                    // Sorting every pass would cost more than the pass.
+                    if (samples.size() % 10 == 0) keep_running = !Converged(policy.ci_width);
+                }
+                else if (settled) keep_running = false;
+            }
+            pending = keep_running ? batch : 0;
+            Start();
+            return keep_running;
+        }
+
+        // Leave out the work between Pause() and Resume() in a pass,
+        // for example setting up the next input.
+        void Pause() {
+            pause_time = Read(tsc, false);
+            if (counters) counters->Read(pause_counts);
+        }
+
+        void Resume() {
+            if (cold) Evict();
+            if (counters) {
+                counters->Read(resume_counts);
+                for (size_t i = 0; i < paused_counts.size(); ++i) {
+                    paused_counts[i] += resume_counts[i] - pause_counts[i];
+                }
+            }
+            paused += Read(tsc, true) - pause_time;
+            ++pauses;
+        }
+
+        // Flush this memory before cold passes instead of all caches.
+        void Evict(const void* p, size_t bytes) {
+            regions.push_back(::std::make_pair(p, bytes));
+        }
+
+        unsigned long Iterations() const {
+            return samples.size();
+        }
+
+        // Passes timed together in each sample.
+        unsigned long Batch() const {
+            return batch;
+        }
+
+        // Every sample in microseconds, in the order taken.
+        const ::std::vector<double>& Samples() const {
+            return samples;
+        }
+
+        // Trimmed mean of the fastest samples in microseconds.
+        // A low, stable estimate for choosing between kernels.
+        double Mean() const {
+            if (fastest.empty()) return 0;
+            auto v = fastest;
+            ::std::sort(v.begin(), v.end());
+            double mean = 0;
+            unsigned long trim = v.size() / 5;
+            for (auto i = trim; i < v.size() - trim; ++i) {
+                mean += v[i];
+            }
+            return mean / (v.size() - trim*2);
+        }
+
+        // Statistics of all samples.
+        Stats Statistics(unsigned resamples = 1000) const {
+            Stats s;
+            s.iterations = samples.size();
+            s.batch = batch;
+            s.cache = cache;
+            for (size_t i = 0; counters && counted && i < counters->Names().size(); ++i) {
+                double count;
+                if (counters->Scale(counts, i, count)) {
+                    s.counters.push_back(::std::make_pair(counters->Names()[i], count / counted));
+                }
+            }
+            Describe(samples, s, resamples);
+            if (tsc) s.cycles = s.median * Tsc::Hz() / 1e6;
+            return s;
+        }
+
+        // Order statistics, moments and the bootstrap confidence
+        // interval of the median of any samples.
+        static void Describe(const ::std::vector<double>& samples, Stats& s, unsigned resamples = 1000) {
+            if (samples.empty()) return;
+            auto sorted = samples;
+            ::std::sort(sorted.begin(), sorted.end());
+            s.min = sorted.front();
+            s.median = Quantile(sorted, 0.5);
+            s.p90 = Quantile(sorted, 0.9);
+            s.p99 = Quantile(sorted, 0.99);
+            for (auto x : sorted) s.mean += x;
+            s.mean /= sorted.size();
+            for (auto x : sorted) s.stddev += (x - s.mean) * (x - s.mean);
+            if (sorted.size() > 1) s.stddev = ::std::sqrt(s.stddev / (sorted.size() - 1));
+            else s.stddev = 0;
+            ::std::vector<double> deviation;
+            for (auto x : sorted) deviation.push_back(::std::abs(x - s.median));
+            s.mad = Median(deviation);
+            // Percentile bootstrap with a fixed seed so runs are repeatable.
+            ::std::minstd_rand rand;
+            ::std::uniform_int_distribution<size_t> pick(0, sorted.size() - 1);
+            ::std::vector<double> medians, resample(sorted.size());
+            for (unsigned r = 0; r < resamples; ++r) {
+                for (auto& x : resample) x = sorted[pick(rand)];
+                auto mid = resample.begin() + resample.size() / 2;
+                ::std::nth_element(resample.begin(), mid, resample.end());
+                medians.push_back(*mid);
+            }
+            ::std::sort(medians.begin(), medians.end());
+            s.ci_low = Quantile(medians, 0.025);
+            s.ci_high = Quantile(medians, 0.975);
+        }
+    };
+
+}
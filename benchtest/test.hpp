@@ -29,63 +29,119 @@ namespace testing {
             return nullptr;
         }
         // Benchmark info
-        std::chrono::high_resolution_clock::time_point start_time;
-        ::std::vector<double> results;
-        unsigned long count = 0;
-        unsigned long size = 0;
-        bool keep_running = true;
+        Sampler sampler;
+        bool reported = false;
+        bool started = false;
+        Policy current;
+        ::std::vector<::std::pair<const void*, size_t>> regions;
+        // Where PauseTiming() goes while the other benchmarks run.
+        Interleave* interleave = nullptr;
+        bool threaded = false;
+        void Report(Stats& stats) {
+            auto name = TestInfo()->name();
+            if (!stats.cache.empty()) name += " " + stats.cache;
+            baseline().Add(name, sampler.Samples(), stats);
+            reporter()->Bench(stats);
+        }
     protected:
         Test() {}
         static void SetUpTestCase() {}
         static void TearDownTestCase() {}
         virtual void SetUp() {}
         virtual void TearDown() {}
+        // When Benchmark() stops, starting from the global policy().
+        Policy policy = ::testing::policy();
+        // Memory to flush from cache before cold passes. Without any,
+        // cold passes evict the whole cache, which may be slow.
+        void Evict(const void* p, size_t bytes) {
+            regions.push_back(::std::make_pair(p, bytes));
+            sampler.Evict(p, bytes);
+        }
+        // Excludes the code between them from the timing of Benchmark(),
+        // BenchmarkInterleaved() and BenchmarkThreads().
+        void PauseTiming() {
+            if (threaded) Threads::Pause();
+            else if (interleave) interleave->Pause();
+            else sampler.Pause();
+        }
+        void ResumeTiming() {
+            if (threaded) Threads::Resume();
+            else if (interleave) interleave->Resume();
+            else sampler.Resume();
+        }
+        // PauseTiming() and ResumeTiming() as Pause() and Resume(), like
+        // Sampler, for helpers that take either.
+        struct Timer {
+            Test& test;
+            void Pause() {
+                test.PauseTiming();
+            }
+            void Resume() {
+                test.ResumeTiming();
+            }
+        };
+        Timer timer{*this};
+        // Throughput of body(thread) run on 1, 2 ... threads threads at
+        // once, by default one for each core, for seconds each.
+        template<typename F>
+        void BenchmarkThreads(F body, unsigned threads = 0, double seconds = 0.2) {
+            if (policy.dry_run) {
+                body(0);
+                return;
+            }
+            if (!threads) threads = Threads::Cores();
+            double single = 0;
+            threaded = true;
+            for (unsigned n = 1; n <= threads; ++n) {
+                auto stats = Threads::Run(n, seconds, body);
+                if (n == 1) single = stats.rate;
+                if (single > 0) stats.efficiency = stats.rate / (single * n);
+                reporter()->Threads(stats);
+            }
+            threaded = false;
+        }
+        // Times of each body and their ratios to the first, with the
+        // samples of all bodies interleaved. See Interleave.
+        void BenchmarkInterleaved(const Interleave::Bodies& bodies, unsigned long max = 100) {
+            if (policy.dry_run) {
+                for (auto& b : bodies) b.second();
+                return;
+            }
+            Interleave ab(bodies);
+            interleave = &ab;
+            auto result = ab.Run(max, policy);
+            interleave = nullptr;
+            for (size_t i = 0; i < result.size(); ++i) {
+                baseline().Add(TestInfo()->name() + " " + result[i].name, ab.Samples(i), result[i].stats);
+            }
+            reporter()->Compare(result);
+        }
         bool Benchmark(unsigned long max = 100) {
-            auto end_time = ::std::chrono::high_resolution_clock::now();
-            double this_time = ::std::chrono::duration<double, std::micro>(end_time - start_time).count();
-            if (!keep_running) return false;
-            if (!size) {
-                size = max / 5;
-                if (size < 10) size = 10;
+            if (policy.dry_run) {
+                if (started) return false;
+                return started = true;
             }
-            if (count) {
-                if (results.size() < size) {
-                    auto it=results.begin();
-                    for (; it!=results.end(); ++it) {
-                        if (*it > this_time) {
-                            results.insert(it, this_time);
-                            break;
-                        }
-                    }
-                    if (it==results.end()) {
-                        results.push_back(this_time);
-                    }
-                }
-                else {
-                    keep_running = false;
-                    for (auto it=results.begin(); it!=results.end(); ++it) {
-                        if (*it > this_time) {
-                            results.pop_back();
-                            results.insert(it, this_time);
-                            keep_running = true;
-                            break;
-                        }
-                    }
-                }
+            if (!started) {
+                started = true;
+                current = policy;
+                if (current.cache == Policy::both) current.cache = Policy::warm;
             }
-            ++count;
-            if (count > max) keep_running = false;
-            if (!keep_running) {
-                double mean = 0;
-                unsigned long trim = results.size() / 5;
-                for (auto i = trim; i < results.size() - trim; ++i) {
-                    mean += results[i];
+            if (sampler.Next(max, current)) return true;
+            if (!reported) {
+                auto stats = sampler.Statistics();
+                if (policy.cache == Policy::both && current.cache == Policy::warm) {
+                    // Report the warm run and start again cold.
+                    stats.cache = "warm";
+                    Report(stats);
+                    current.cache = Policy::cold;
+                    sampler = Sampler();
+                    for (auto& r : regions) sampler.Evict(r.first, r.second);
+                    return sampler.Next(max, current);
                 }
-                mean /= results.size() - trim*2;
-                reporter()->Bench(count-1, mean);
+                reported = true;
+                Report(stats);
             }
-            start_time = ::std::chrono::high_resolution_clock::now();
-            return keep_running;
+            return false;
         }
     public:
         virtual bool HasFatalFailure() {
@@ -0,0 +1,141 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Throughput of one run of Threads::Run().
+    struct ThreadStats {
+        unsigned threads = 0;
+        double seconds = 0;
+        // Calls per second of all threads together.
+        double rate = 0;
+        // Calls per second of each thread.
+        double mean = 0;
+        double stddev = 0;
+        double min = 0;
+        double max = 0;
+        // rate over threads times the one thread rate, if known.
+        double efficiency = 0;
+    };
+
+    // Runs independent work on several threads at once to measure how
+    // throughput scales when they share memory bandwidth and caches.
+    class Threads {
+        // CPUs this process may run on.
+        static ::std::vector<int> Cpus() {
+            ::std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int i = 0; i < CPU_SETSIZE; ++i) {
+                    if (CPU_ISSET(i, &set)) cpus.push_back(i);
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        static void Pin(const ::std::vector<int>& cpus, unsigned index) {
+#ifdef __linux__
+            if (cpus.empty()) return;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[index % cpus.size()], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+
+        // Seconds this thread spent between Pause() and Resume().
+        static double& Paused() {
+            static thread_local double paused = 0;
+            return paused;
+        }
+        static ::std::chrono::steady_clock::time_point& PauseStart() {
+            static thread_local ::std::chrono::steady_clock::time_point start;
+            return start;
+        }
+
+    public:
+        static unsigned Cores() {
+            auto n = Cpus().size();
+            if (!n) n = ::std::thread::hardware_concurrency();
+            return n ? n : 1;
+        }
+
+        // Leave the work between them out of the calling thread's time
+        // in Run(), for example setting up its next input.
+        static void Pause() {
+            PauseStart() = ::std::chrono::steady_clock::now();
+        }
+        static void Resume() {
+            Paused() += ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - PauseStart()).count();
+        }
+
+        // Calls body(index) over and over on threads 0..threads-1, each
+        // pinned to its own CPU where possible, for about seconds. All
+        // threads wait at a barrier so they start together.
+        template<typename F>
+        static ThreadStats Run(unsigned threads, double seconds, F body) {
+            auto cpus = Cpus();
+            ::std::atomic<unsigned> ready(0);
+            ::std::atomic<bool> go(false), stop(false);
+            ::std::vector<unsigned long> calls(threads);
+            ::std::vector<double> elapsed(threads);
+            ::std::vector<::std::thread> pool;
+            for (unsigned i = 0; i < threads; ++i) {
+                pool.push_back(::std::thread([&, i] {
+                    Pin(cpus, i);
+                    ++ready;
+                    while (!go) ::std::this_thread::yield();
+                    Paused() = 0;
+                    auto start = ::std::chrono::steady_clock::now();
+                    unsigned long n = 0;
+                    while (!stop.load(::std::memory_order_relaxed)) {
+                        body(i);
+                        ++n;
+                    }
+                    auto end = ::std::chrono::steady_clock::now();
+                    calls[i] = n;
+                    elapsed[i] = ::std::chrono::duration<double>(end - start).count() - Paused();
+                }));
+            }
+            while (ready < threads) ::std::this_thread::yield();
+            go = true;
+            ::std::this_thread::sleep_for(::std::chrono::duration<double>(seconds));
+            stop = true;
+            for (auto& t : pool) t.join();
+
+            ThreadStats s;
+            s.threads = threads;
+            s.seconds = seconds;
+            s.min = 1e300;
+            for (unsigned i = 0; i < threads; ++i) {
+                double r = elapsed[i] > 0 ? calls[i] / elapsed[i] : 0;
+                s.rate += r;
+                s.min = ::std::min(s.min, r);
+                s.max = ::std::max(s.max, r);
+            }
+            s.mean = s.rate / threads;
+            for (unsigned i = 0; i < threads; ++i) {
+                double r = elapsed[i] > 0 ? calls[i] / elapsed[i] : 0;
+                s.stddev += (r - s.mean) * (r - s.mean);
+            }
+            s.stddev = threads > 1 ? ::std::sqrt(s.stddev / (threads - 1)) : 0;
+            return s;
+        }
+    };
+
+}
@@ -0,0 +1,83 @@
+// benchtest - A benchmarking and unit testing framework.
+// Copyright (C) 2014 David Turnbull
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+namespace testing {
+
+    // Time stamp counter of x86 processors. The counter runs at a fixed
+    // rate on processors with an invariant TSC, so differences convert
+    // to time with one calibrated frequency. It counts reference cycles
+    // at that rate, not core cycles, which vary with the clock speed.
+    class Tsc {
+    public:
+        // True on x86 when the TSC is invariant and rdtscp exists.
+        static bool Available() {
+#if defined(BENCHTEST_X86)
+            static const bool available = [] {
+                unsigned a = 0, b = 0, c = 0, d = 0;
+                if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) return false;
+                __get_cpuid(0x80000001, &a, &b, &c, &d);
+                bool rdtscp = d & (1u << 27);
+                __get_cpuid(0x80000007, &a, &b, &c, &d);
+                bool invariant = d & (1u << 8);
+                return rdtscp && invariant;
+            }();
+            return available;
+#else
+            return false;
+#endif
+        }
+
+        // Read before the timed code. The fence keeps earlier
+        // instructions from finishing inside the interval.
+        static uint64_t Start() {
+#if defined(BENCHTEST_X86)
+            _mm_lfence();
+            return __rdtsc();
+#else
+            return 0;
+#endif
+        }
+
+        // Read after the timed code. rdtscp waits for earlier
+        // instructions and the fence keeps later ones out.
+        static uint64_t Stop() {
+#if defined(BENCHTEST_X86)
+            unsigned aux;
+            uint64_t t = __rdtscp(&aux);
+            _mm_lfence();
+            return t;
+#else
+            return 0;
+#endif
+        }
+
+        // Counts per second, measured once against steady_clock.
+        static double Hz() {
+            static const double hz = [] {
+                if (!Available()) return 0.0;
+                typedef ::std::chrono::steady_clock clock;
+                auto t0 = clock::now();
+                uint64_t c0 = Start();
+                auto t1 = t0;
+                while (t1 - t0 < ::std::chrono::milliseconds(20)) t1 = clock::now();
+                uint64_t c1 = Stop();
+                return (c1 - c0) / ::std::chrono::duration<double>(t1 - t0).count();
+            }();
+            return hz;
+        }
+    };
+
+}
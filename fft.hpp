@@ -26,6 +26,26 @@
 #include <vector>
 #include <cmath>
 
+// Largest size compiled as a fully unrolled template by the Hybrid mixer.
+#ifndef FFT_HYBRID_LEAF
+#define FFT_HYBRID_LEAF 256
+#endif
+
+// Largest size the Auto mixer runs breadth-first. From the sweep.cpp
+// fft and breadthfirst rows, 8 to 2^22 points in float and double:
+// breadth-first is never reliably faster, ties to 16 points, and is 0-10%
+// slower to 2^16 and up to 25% slower above. Rerun the sweep on another
+// target to move it, or let Plan::Planner pick per size at run time.
+#ifndef FFT_BREADTH_FIRST_MAX
+#define FFT_BREADTH_FIRST_MAX 16
+#endif
+
+// Mixer used by Transform when none is given.
+// Butterfly, Hybrid, BreadthFirst or Auto.
+#ifndef FFT_MIXER
+#define FFT_MIXER Butterfly
+#endif
+
 /// \brief FFT - discrete Fourier transforms
 /// \author David Turnbull
 /// \copyright MIT License
@@ -51,6 +71,21 @@
 ///     std::array<std::complex<double>,64> in;
 ///     std::array<std::complex<double>,64> out;
 ///     FFT::dft(in, out);
+///
+/// Each size normally compiles to its own chain of Butterfly functions.
+/// When many sizes are in use, the Hybrid mixer shares one runtime loop
+/// for all levels above FFT_HYBRID_LEAF points to save code and I-cache:
+///
+///     FFT::Transform<float, 65536, FFT::Hybrid>::dft(data);
+///
+/// Defining FFT_MIXER as Hybrid before including makes it the default.
+///
+/// Butterfly works depth first, finishing each quarter before mixing
+/// the next level, which keeps large transforms in cache. BreadthFirst
+/// runs one level at a time over the whole array, giving long simple
+/// loops that vectorize better while the data still fits in cache.
+/// Auto uses BreadthFirst up to FFT_BREADTH_FIRST_MAX points and
+/// Butterfly above. The planner in planner.hpp times both per size.
 
 namespace FFT {
 
@@ -84,12 +119,10 @@ namespace FFT {
         *reinterpret_cast<std::array<std::complex<T>, N/4>*>(twiddles<T>(3,D,N).data())
     );
 
-    // Recursive template for butterfly mixing.
-    template<typename T, int D, size_t N>
-    class Butterfly {
-        static const Twiddle<T, D, N> twiddle;
-        static const size_t N4 = N/4;
-        static Butterfly<T, D, N4> next;
+    // Radix-4 arithmetic shared by the mixers.
+    template<typename T, int D>
+    class Radix4 {
+    protected:
         // Simplified multiplication for direction product.
         static std::complex<T> direction(const std::complex<T>& z)
         {
@@ -104,16 +137,13 @@ namespace FFT {
                        z.imag()*w.real() + z.real()*w.imag()
                    );
         }
-    public:
-        // Radix-4 mixer
-        static void mix(std::complex<T>* data) {
-            size_t i1 = N4;
-            size_t i2 = N4 * 2;
-            size_t i3 = N4 * 3;
-            next.mix(data);
-            next.mix(data+i1);
-            next.mix(data+i2);
-            next.mix(data+i3);
+        // Radix-4 butterflies of one level of n4*4 points, the kernel of
+        // every mixer. Called with a constant n4 it inlines like a template.
+        static void combine(std::complex<T>* data, size_t n4, const std::complex<T>* t1,
+                            const std::complex<T>* t2, const std::complex<T>* t3) {
+            size_t i1 = n4;
+            size_t i2 = n4 * 2;
+            size_t i3 = n4 * 3;
             // Index 0 twiddles are always (1+0i).
             std::complex<T> a0 = data[0];
             std::complex<T> a2 = data[i1];
@@ -126,14 +156,14 @@ namespace FFT {
             data[i2] = a0 + a2 - b0;
             data[i3] = a0 - a2 - b1;
             // Index 1+ must multiply twiddles.
-            for (size_t i0=1; i0 < N4; ++i0) {
-                i1 = i0 + N4;
-                i2 = i1 + N4;
-                i3 = i2 + N4;
+            for (size_t i0=1; i0 < n4; ++i0) {
+                i1 = i0 + n4;
+                i2 = i1 + n4;
+                i3 = i2 + n4;
                 a0 = data[i0];
-                a2 = multiply(data[i1], twiddle.t2[i0]);
-                a1 = multiply(data[i2], twiddle.t1[i0]);
-                a3 = multiply(data[i3], twiddle.t3[i0]);
+                a2 = multiply(data[i1], t2[i0]);
+                a1 = multiply(data[i2], t1[i0]);
+                a3 = multiply(data[i3], t3[i0]);
                 b0 = a1 + a3;
                 b1 = direction(a1-a3);
                 data[i0] = a0 + a2 + b0;
@@ -144,6 +174,23 @@ namespace FFT {
         }
     };
 
+    // Recursive template for butterfly mixing.
+    template<typename T, int D, size_t N>
+    class Butterfly : Radix4<T, D> {
+        static const Twiddle<T, D, N> twiddle;
+        static const size_t N4 = N/4;
+        static Butterfly<T, D, N4> next;
+    public:
+        // Radix-4 mixer
+        static void mix(std::complex<T>* data) {
+            next.mix(data);
+            next.mix(data+N4);
+            next.mix(data+N4*2);
+            next.mix(data+N4*3);
+            Radix4<T, D>::combine(data, N4, twiddle.t1.data(), twiddle.t2.data(), twiddle.t3.data());
+        }
+    };
+
     // Terminates template recursion when not power of 4.
     template<typename T, int D>
     class Butterfly<T, D, 2> {
@@ -161,11 +208,134 @@ namespace FFT {
     template<typename T, int D>
     class Butterfly<T, D, 1> {
     public:
-        static void mix(std::complex<T>* data) {
+        static void mix(std::complex<T>*) {
             // Do nothing.
         }
     };
 
+    // Runtime radix-4 mixer for the levels above the hybrid leaf.
+    // The levels share this one copy of code and read their twiddles
+    // through tw, which holds t1, t2 and t3 for each level from the top.
+    template<typename T, int D>
+    class Strided : Radix4<T, D> {
+        static const size_t L = FFT_HYBRID_LEAF;
+        static_assert(L >= 4 && !(L & (L - 1)), "FFT_HYBRID_LEAF must be a power of two.");
+    public:
+        static void mix(std::complex<T>* data, size_t n, const std::complex<T>* const* tw) {
+            if (n == L) return Butterfly<T, D, L>::mix(data);
+            if (n == L/2) return Butterfly<T, D, L/2>::mix(data);
+            size_t n4 = n/4;
+            mix(data, n4, tw + 3);
+            mix(data + n4, n4, tw + 3);
+            mix(data + n4*2, n4, tw + 3);
+            mix(data + n4*3, n4, tw + 3);
+            Radix4<T, D>::combine(data, n4, tw[0], tw[1], tw[2]);
+        }
+    };
+
+    // Collects the twiddle tables used by Strided for size N.
+    template<typename T, int D, size_t N, bool = (N > FFT_HYBRID_LEAF)>
+    struct Levels {
+        static void fill(const std::complex<T>** tw) {
+            tw[0] = &Twiddle<T, D, N>::t1[0];
+            tw[1] = &Twiddle<T, D, N>::t2[0];
+            tw[2] = &Twiddle<T, D, N>::t3[0];
+            Levels<T, D, N/4>::fill(tw + 3);
+        }
+    };
+    template<typename T, int D, size_t N>
+    struct Levels<T, D, N, false> {
+        static void fill(const std::complex<T>**) {
+        }
+    };
+
+    // Top of the Strided recursion with its table of twiddles.
+    template<typename T, int D, size_t N, bool = (N > FFT_HYBRID_LEAF)>
+    class HybridTop {
+        struct Table {
+            const std::complex<T>* tw[3 * 32];
+            Table() {
+                Levels<T, D, N>::fill(tw);
+            }
+        };
+    public:
+        static void mix(std::complex<T>* data) {
+            static const Table table;
+            Strided<T, D>::mix(data, N, table.tw);
+        }
+    };
+    template<typename T, int D, size_t N>
+    class HybridTop<T, D, N, false> : public Butterfly<T, D, N> {
+    };
+
+    // Hybrid mixer: sizes up to FFT_HYBRID_LEAF are Butterfly templates,
+    // larger sizes run the shared Strided loop down to a leaf. This trades
+    // a little speed for much less code when many sizes are in use.
+    template<typename T, int D, size_t N>
+    class Hybrid : public HybridTop<T, D, N> {
+    };
+
+    // One level of the breadth-first mixer. Mixes every block of L
+    // points in data[0..n-1] after all the smaller levels are done.
+    // The code for a level is shared by every transform size.
+    template<typename T, int D, size_t L>
+    class Stage : Radix4<T, D> {
+        static const Twiddle<T, D, L> twiddle;
+        static const size_t L4 = L/4;
+    public:
+        static void mix(std::complex<T>* data, size_t n) {
+            Stage<T, D, L4>::mix(data, n);
+            for (std::complex<T>* x = data; x < data + n; x += L) {
+                Radix4<T, D>::combine(x, L4, twiddle.t1.data(), twiddle.t2.data(), twiddle.t3.data());
+            }
+        }
+    };
+
+    // First level when not power of 4.
+    template<typename T, int D>
+    class Stage<T, D, 2> {
+    public:
+        static void mix(std::complex<T>* data, size_t n) {
+            for (std::complex<T>* x = data; x < data + n; x += 2) {
+                std::complex<T> a0 = x[0];
+                std::complex<T> a1 = x[1];
+                x[0] = a0 + a1;
+                x[1] = a0 - a1;
+            }
+        }
+    };
+
+    // Nothing below the first level for powers of 4.
+    template<typename T, int D>
+    class Stage<T, D, 1> {
+    public:
+        static void mix(std::complex<T>*, size_t) {
+        }
+    };
+
+    // Breadth-first mixer: the same arithmetic as Butterfly, done one
+    // level at a time across the whole array.
+    template<typename T, int D, size_t N>
+    class BreadthFirst {
+    public:
+        static void mix(std::complex<T>* data) {
+            Stage<T, D, N>::mix(data, N);
+        }
+    };
+
+    // Picks the traversal by size.
+    template<typename T, int D, size_t N, bool = (N <= FFT_BREADTH_FIRST_MAX)>
+    class AutoTop : public BreadthFirst<T, D, N> {
+    };
+    template<typename T, int D, size_t N>
+    class AutoTop<T, D, N, false> : public Butterfly<T, D, N> {
+    };
+
+    // Auto mixer: BreadthFirst up to FFT_BREADTH_FIRST_MAX, then Butterfly.
+    template<typename T, int D, size_t N>
+    class Auto : public AutoTop<T, D, N> {
+    };
+
     // Bit reversal pattern
     template<size_t N, bool ispow4>
     struct BitReverse {
@@ -192,7 +362,7 @@ namespace FFT {
     );
 
     // Start of Fourier Transforms.
-    template<typename T, size_t N>
+    template<typename T, size_t N, template<typename, int, size_t> class M = FFT_MIXER>
     class Transform {
         static_assert((N > 1) & !(N & (N - 1)), "Array size must be a power of two.");
         static constexpr bool ispow4_impl(size_t n, size_t m ) {
@@ -295,24 +465,36 @@ namespace FFT {
             }
         }
     public:
-        static void dft(std::array<std::complex<T>, N> &data) {
-            reindex(data);
-            Butterfly<T, -1, N>::mix(&data[0]);
-        }
-        static void idft(std::array<std::complex<T>, N> &data) {
-            reindex(data);
-            Butterfly<T, 1, N>::mix(&data[0]);
-        }
-        static void dft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out) {
-            reindex(in, out);
-            Butterfly<T, -1, N>::mix(&out[0]);
-        }
-        static void idft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out) {
-            reindex(in, out);
-            Butterfly<T, 1, N>::mix(&out[0]);
-        }
+        static void dft(std::array<std::complex<T>, N> &data);
+        static void idft(std::array<std::complex<T>, N> &data);
+        static void dft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out);
+        static void idft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out);
     };
 
+    // Defined outside the class so they are not implicitly inline.
+    // This lets an extern template declaration keep them, and the whole
+    // Butterfly recursion below them, out of every translation unit.
+    template<typename T, size_t N, template<typename, int, size_t> class M>
+    void Transform<T, N, M>::dft(std::array<std::complex<T>, N> &data) {
+        reindex(data);
+        M<T, -1, N>::mix(&data[0]);
+    }
+    template<typename T, size_t N, template<typename, int, size_t> class M>
+    void Transform<T, N, M>::idft(std::array<std::complex<T>, N> &data) {
+        reindex(data);
+        M<T, 1, N>::mix(&data[0]);
+    }
+    template<typename T, size_t N, template<typename, int, size_t> class M>
+    void Transform<T, N, M>::dft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out) {
+        reindex(in, out);
+        M<T, -1, N>::mix(&out[0]);
+    }
+    template<typename T, size_t N, template<typename, int, size_t> class M>
+    void Transform<T, N, M>::idft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out) {
+        reindex(in, out);
+        M<T, 1, N>::mix(&out[0]);
+    }
+
     /// Discrete Fourier transform.
     template<typename T, size_t N>
     inline void dft(std::array<std::complex<T>, N> &data) {
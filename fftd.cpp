@@ -0,0 +1,30 @@
+// FFT service daemon. See fftd.hpp for the protocol.
+// Run with:
+// g++ -o fftd -std=c++11 -O3 -pthread fftd.cpp && ./fftd /tmp/fftd.sock
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+
+#include "fftd.hpp"
+
+static Service::Server<20>* server;
+
+static void terminate(int) {
+    server->stop();
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "/tmp/fftd.sock";
+    unsigned window = argc > 2 ? std::atoi(argv[2]) : 20;
+    server = new Service::Server<20>(path, window);
+    if (!server->good()) {
+        std::perror(path);
+        return EXIT_FAILURE;
+    }
+    std::signal(SIGINT, terminate);
+    std::signal(SIGTERM, terminate);
+    server->run();
+    delete server;
+    return EXIT_SUCCESS;
+}
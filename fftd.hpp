@@ -0,0 +1,444 @@
+// Local FFT service over a Unix domain socket.
+//
+// Clients share a memory buffer with the server once, by passing its
+// file descriptor over the socket, and afterwards send small requests
+// naming an offset and size inside that buffer. Samples never cross the
+// socket. The server collects requests for a short window after the
+// first one arrives, sorts them by type, direction and size, and runs
+// each group back to back through FFT::Transform so the twiddle tables
+// and code for one size stay hot for the whole batch.
+//
+// Example server:
+//
+//     Service::Server<> server("/tmp/fftd.sock");
+//     server.run();
+//
+// Example client:
+//
+//     Service::Client client("/tmp/fftd.sock", 1 << 20);
+//     std::complex<float>* data = client.buffer<float>();
+//     // Fill data[0..1023]
+//     client.dft<float>(0, 1024);
+
+#ifndef fftbench_fftd_hpp
+#define fftbench_fftd_hpp
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "fft.hpp"
+
+namespace Service {
+
+    enum Type : uint32_t {
+        float32 = 0,
+        float64 = 1
+    };
+
+    struct Attach {
+        uint64_t magic;
+        uint64_t size;
+    };
+
+    struct Request {
+        uint32_t type;
+        int32_t direction;
+        uint32_t log2n;
+        uint32_t id;
+        uint64_t offset;
+    };
+
+    struct Reply {
+        uint32_t id;
+        int32_t status;
+    };
+
+    static const uint64_t magic = 0x31445446464e4958ull;
+
+    inline bool send_all(int fd, const void* buf, size_t len) {
+        auto p = static_cast<const char*>(buf);
+        while (len) {
+            auto n = ::send(fd, p, len, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    inline bool recv_all(int fd, void* buf, size_t len) {
+        auto p = static_cast<char*>(buf);
+        while (len) {
+            auto n = ::recv(fd, p, len, 0);
+            if (n <= 0) return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    inline bool address(const std::string& path, sockaddr_un& addr) {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    // Runtime dispatch from log2n to the compile time transforms.
+    typedef void (*Kernel)(void*);
+
+    template<typename T, size_t N>
+    struct Entry {
+        static void dft(void* p) {
+            FFT::Transform<T, N>::dft(*static_cast<std::array<std::complex<T>, N>*>(p));
+        }
+        static void idft(void* p) {
+            FFT::Transform<T, N>::idft(*static_cast<std::array<std::complex<T>, N>*>(p));
+        }
+    };
+
+    template<size_t L, size_t M>
+    struct Kernels {
+        static void fill(Kernel (&k)[2][2][M + 1]) {
+            k[float32][0][L] = Entry<float, size_t(1) << L>::dft;
+            k[float32][1][L] = Entry<float, size_t(1) << L>::idft;
+            k[float64][0][L] = Entry<double, size_t(1) << L>::dft;
+            k[float64][1][L] = Entry<double, size_t(1) << L>::idft;
+            Kernels<L - 1, M>::fill(k);
+        }
+    };
+
+    template<size_t M>
+    struct Kernels<0, M> {
+        static void fill(Kernel (&)[2][2][M + 1]) {
+        }
+    };
+
+    /// Serves transforms up to 2^MaxLog2 points.
+    template<size_t MaxLog2 = 16>
+    class Server {
+        struct Connection {
+            int fd;
+            int shm;
+            unsigned char* base;
+            size_t size;
+            std::vector<char> in;
+        };
+        struct Pending {
+            size_t conn;
+            Request req;
+        };
+
+        std::string path;
+        int listener = -1;
+        std::chrono::nanoseconds window;
+        size_t max_batch;
+        std::vector<Connection> conns;
+        std::vector<pollfd> fds;
+        std::vector<Pending> pending;
+        std::atomic<bool> running;
+        std::atomic<uint64_t> batch_count;
+        std::atomic<uint64_t> request_count;
+        Kernel kernels[2][2][MaxLog2 + 1];
+
+        // The handshake is read from the poll loop like any request so a
+        // client that connects and stays silent cannot stall the others.
+        void accept() {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) return;
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            conns.push_back(Connection{fd, -1, nullptr, 0, {}});
+        }
+
+        // Map the buffer passed by a new connection. The client's claim
+        // is checked against the object it passed so a short object can
+        // not fault the server on its first transform.
+        bool attach(Connection& c) {
+            Attach a;
+            char cbuf[CMSG_SPACE(sizeof(int))];
+            iovec iov = {&a, sizeof(a)};
+            msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = cbuf;
+            msg.msg_controllen = sizeof(cbuf);
+            ssize_t n = ::recvmsg(c.fd, &msg, MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            cmsghdr* m = CMSG_FIRSTHDR(&msg);
+            if (m && m->cmsg_level == SOL_SOCKET && m->cmsg_type == SCM_RIGHTS) {
+                std::memcpy(&c.shm, CMSG_DATA(m), sizeof(int));
+            }
+            if (n != sizeof(a) || a.magic != magic || c.shm < 0 || a.size == 0) return false;
+            struct stat st;
+            if (::fstat(c.shm, &st) || st.st_size < 0 || uint64_t(st.st_size) < a.size) return false;
+            void* p = ::mmap(nullptr, a.size, PROT_READ | PROT_WRITE, MAP_SHARED, c.shm, 0);
+            if (p == MAP_FAILED) return false;
+            c.base = static_cast<unsigned char*>(p);
+            c.size = a.size;
+            return true;
+        }
+
+        void drop(Connection& c) {
+            if (c.base) ::munmap(c.base, c.size);
+            if (c.shm >= 0) ::close(c.shm);
+            ::close(c.fd);
+            c.fd = -1;
+        }
+
+        // Read every complete request waiting on ready connections.
+        void collect(int timeout) {
+            fds.resize(conns.size() + 1);
+            fds[0] = pollfd{listener, POLLIN, 0};
+            for (size_t i = 0; i < conns.size(); ++i) {
+                fds[i + 1] = pollfd{conns[i].fd, POLLIN, 0};
+            }
+            if (::poll(fds.data(), fds.size(), timeout) <= 0) return;
+            for (size_t i = 0; i < conns.size(); ++i) {
+                if (!fds[i + 1].revents) continue;
+                Connection& c = conns[i];
+                if (!c.base) {
+                    if (!attach(c)) drop(c);
+                    continue;
+                }
+                char buf[4096];
+                ssize_t n;
+                while ((n = ::recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                    c.in.insert(c.in.end(), buf, buf + n);
+                }
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    drop(c);
+                    continue;
+                }
+                size_t used = 0;
+                for (; used + sizeof(Request) <= c.in.size(); used += sizeof(Request)) {
+                    Pending p;
+                    p.conn = i;
+                    std::memcpy(&p.req, &c.in[used], sizeof(Request));
+                    pending.push_back(p);
+                }
+                c.in.erase(c.in.begin(), c.in.begin() + used);
+            }
+            if (fds[0].revents & POLLIN) accept();
+        }
+
+        int32_t execute(const Request& r, Connection& c) {
+            if (r.type > float64 || r.log2n < 1 || r.log2n > MaxLog2) return -1;
+            size_t point = r.type == float32 ? sizeof(std::complex<float>) : sizeof(std::complex<double>);
+            size_t bytes = point << r.log2n;
+            if (r.offset % point || r.offset > c.size || bytes > c.size - r.offset) return -1;
+            // The client may shrink its object at any time.
+            struct stat st;
+            if (::fstat(c.shm, &st) || st.st_size < 0 || uint64_t(st.st_size) < r.offset + bytes) return -1;
+            kernels[r.type][r.direction > 0][r.log2n](c.base + r.offset);
+            return 0;
+        }
+
+        void dispatch() {
+            std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+                if (a.req.type != b.req.type) return a.req.type < b.req.type;
+                if (a.req.direction != b.req.direction) return a.req.direction < b.req.direction;
+                return a.req.log2n < b.req.log2n;
+            });
+            for (auto& p : pending) {
+                Connection& c = conns[p.conn];
+                if (c.fd < 0) continue;
+                Reply reply = {p.req.id, execute(p.req, c)};
+                if (!send_all(c.fd, &reply, sizeof(reply))) drop(c);
+            }
+            request_count += pending.size();
+            ++batch_count;
+            pending.clear();
+        }
+
+        void compact() {
+            conns.erase(std::remove_if(conns.begin(), conns.end(), [](const Connection& c) {
+                return c.fd < 0;
+            }), conns.end());
+        }
+
+    public:
+        /// Requests arriving within window_us of the first are batched together.
+        Server(const std::string& path, unsigned window_us = 20, size_t max_batch = 64) :
+            path(path),
+            window(std::chrono::microseconds(window_us)),
+            max_batch(max_batch),
+            running(true),
+            batch_count(0),
+            request_count(0) {
+            Kernels<MaxLog2, MaxLog2>::fill(kernels);
+            sockaddr_un addr;
+            if (!address(path, addr)) return;
+            ::unlink(path.c_str());
+            listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0) return;
+            if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+                ::listen(listener, 128)) {
+                ::close(listener);
+                listener = -1;
+            }
+        }
+
+        ~Server() {
+            for (auto& c : conns) {
+                if (c.fd >= 0) drop(c);
+            }
+            if (listener >= 0) {
+                ::close(listener);
+                ::unlink(path.c_str());
+            }
+        }
+
+        bool good() const {
+            return listener >= 0;
+        }
+
+        /// Serve until stop() is called from another thread.
+        void run() {
+            while (running) {
+                collect(10);
+                if (!pending.empty()) {
+                    auto deadline = std::chrono::steady_clock::now() + window;
+                    while (pending.size() < max_batch && std::chrono::steady_clock::now() < deadline) {
+                        collect(0);
+                    }
+                    dispatch();
+                }
+                compact();
+            }
+        }
+
+        void stop() {
+            running = false;
+        }
+
+        uint64_t batches() const {
+            return batch_count;
+        }
+
+        uint64_t requests() const {
+            return request_count;
+        }
+    };
+
+    /// One connection with its shared buffer.
+    /// Each client has at most one request in flight.
+    class Client {
+        int fd = -1;
+        unsigned char* base = nullptr;
+        size_t size;
+        uint32_t next_id = 0;
+
+        bool request(Type type, int direction, size_t n, size_t offset) {
+            uint32_t log2n = 0;
+            while ((size_t(1) << log2n) < n) ++log2n;
+            if ((size_t(1) << log2n) != n) return false;
+            Request r = {type, direction, log2n, ++next_id, offset};
+            Reply reply;
+            if (!send_all(fd, &r, sizeof(r)) || !recv_all(fd, &reply, sizeof(reply))) return false;
+            return reply.id == r.id && reply.status == 0;
+        }
+
+        template<typename T>
+        static Type type();
+
+    public:
+        Client(const std::string& path, size_t bytes) : size(bytes) {
+            sockaddr_un addr;
+            if (!address(path, addr)) return;
+            static std::atomic<unsigned> serial(0);
+            std::string name = "/fftd." + std::to_string(::getpid()) + "." + std::to_string(serial++);
+            int shm = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (shm < 0) return;
+            ::shm_unlink(name.c_str());
+            void* p = MAP_FAILED;
+            if (::ftruncate(shm, bytes) == 0) {
+                p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+            }
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            bool ok = p != MAP_FAILED && fd >= 0 &&
+                      ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+            if (ok) {
+                Attach a = {magic, bytes};
+                char cbuf[CMSG_SPACE(sizeof(int))];
+                std::memset(cbuf, 0, sizeof(cbuf));
+                iovec iov = {&a, sizeof(a)};
+                msghdr msg;
+                std::memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = cbuf;
+                msg.msg_controllen = sizeof(cbuf);
+                cmsghdr* c = CMSG_FIRSTHDR(&msg);
+                c->cmsg_level = SOL_SOCKET;
+                c->cmsg_type = SCM_RIGHTS;
+                c->cmsg_len = CMSG_LEN(sizeof(int));
+                std::memcpy(CMSG_DATA(c), &shm, sizeof(int));
+                ok = ::sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(a);
+            }
+            ::close(shm);
+            if (p != MAP_FAILED) base = static_cast<unsigned char*>(p);
+            if (!ok && fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        ~Client() {
+            if (fd >= 0) ::close(fd);
+            if (base) ::munmap(base, size);
+        }
+
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        bool good() const {
+            return fd >= 0 && base;
+        }
+
+        template<typename T>
+        std::complex<T>* buffer(size_t offset = 0) {
+            return reinterpret_cast<std::complex<T>*>(base + offset);
+        }
+
+        /// Transform n points starting at byte offset in the shared buffer.
+        template<typename T>
+        bool dft(size_t offset, size_t n) {
+            return request(type<T>(), -1, n, offset);
+        }
+
+        template<typename T>
+        bool idft(size_t offset, size_t n) {
+            return request(type<T>(), 1, n, offset);
+        }
+    };
+
+    template<>
+    inline Type Client::type<float>() {
+        return float32;
+    }
+
+    template<>
+    inline Type Client::type<double>() {
+        return float64;
+    }
+
+}
+
+#endif
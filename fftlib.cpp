@@ -0,0 +1,9 @@
+// Explicit instantiations for fftlib.hpp.
+// Build with:
+// g++ -c -std=c++11 -O3 fftlib.cpp
+
+#define FFTLIB_INSTANTIATE
+#include "fftlib.hpp"
+
+#define FFTLIB_INSTANTIATE_(T, N) template class FFT::Transform<T, N, FFT::Butterfly>;
+FFTLIB_TYPES(FFTLIB_INSTANTIATE_)
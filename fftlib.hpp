@@ -0,0 +1,37 @@
+// Precompiled FFT::Transform instantiations.
+//
+// Including this header instead of fft.hpp declares the common sizes as
+// extern templates, so translation units call into fftlib.cpp instead of
+// compiling the Butterfly recursion and twiddle tables themselves.
+// Sizes not listed here still work and are compiled inline as usual.
+// The library holds the Butterfly mixer, named explicitly so a different
+// FFT_MIXER in the including file compiles its own transforms inline
+// instead of expecting them from fftlib.o.
+//
+// Build and link with:
+//
+//     g++ -c -std=c++11 -O3 fftlib.cpp
+//     g++ -o app -std=c++11 -O3 app.cpp fftlib.o
+
+#ifndef fftbench_fftlib_hpp
+#define fftbench_fftlib_hpp
+
+#include "fft.hpp"
+
+// Types and sizes compiled into fftlib.cpp, 2^4 through 2^20.
+#define FFTLIB_SIZES(X, T) \
+X(T, 16) X(T, 32) X(T, 64) X(T, 128) X(T, 256) X(T, 512) X(T, 1024) \
+X(T, 2048) X(T, 4096) X(T, 8192) X(T, 16384) X(T, 32768) X(T, 65536) \
+X(T, 131072) X(T, 262144) X(T, 524288) X(T, 1048576)
+
+#define FFTLIB_TYPES(X) \
+FFTLIB_SIZES(X, float) \
+FFTLIB_SIZES(X, double)
+
+#ifndef FFTLIB_INSTANTIATE
+#define FFTLIB_EXTERN_(T, N) extern template class FFT::Transform<T, N, FFT::Butterfly>;
+FFTLIB_TYPES(FFTLIB_EXTERN_)
+#undef FFTLIB_EXTERN_
+#endif
+
+#endif
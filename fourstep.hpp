@@ -0,0 +1,76 @@
+// Helpers for the four-step FFT decomposition.
+//
+// A transform of N = N1*N2 points is viewed as a matrix x[n1][n2] with
+// N1 rows and N2 columns. The four steps are:
+//
+//  1. Transform each column with an N1-point FFT over n1.
+//  2. Multiply element [k1][n2] by the twiddle W_N^(n2*k1).
+//  3. Transform each row with an N2-point FFT over n2.
+//  4. Transpose, so X[k1 + N1*k2] is read from [k1][k2].
+//
+// Each step needs only N1 or N2 points at once, so the transforms can
+// be done by the in-memory kernels on pieces of a much larger array.
+
+#ifndef fftbench_fourstep_hpp
+#define fftbench_fourstep_hpp
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <cmath>
+
+#include "fft.hpp"
+
+namespace FourStep {
+
+    /// Multiply x[k1], k1 = 0..n1-1, by W_n^(n2*k1).
+    /// Twiddles are advanced by recurrence in double precision and
+    /// recomputed exactly every 64 points so large n stays accurate.
+    template<typename T, int D>
+    void twiddle(std::complex<T>* x, size_t n1, uint64_t n2, uint64_t n) {
+        const double theta = D * 2 * M_PI / n;
+        const std::complex<double> step = std::polar(1.0, theta * double(n2 % n));
+        std::complex<double> w;
+        for (size_t k1 = 0; k1 < n1; ++k1) {
+            if (k1 % 64 == 0) w = std::polar(1.0, theta * double((n2 * k1) % n));
+            x[k1] = std::complex<T>(std::complex<double>(x[k1]) * w);
+            w *= step;
+        }
+    }
+
+    /// In-place transform of n contiguous points in the direction D.
+    template<typename T, int D, size_t N>
+    inline void transform(std::complex<T>* x) {
+        auto& a = *reinterpret_cast<std::array<std::complex<T>, N>*>(x);
+        if (D < 0) FFT::Transform<T, N>::dft(a);
+        else FFT::Transform<T, N>::idft(a);
+    }
+
+    /// Copy columns [col, col+count) of a rows x cols matrix into
+    /// count contiguous vectors of length rows.
+    template<typename T>
+    void gather(const std::complex<T>* m, size_t rows, size_t cols,
+                size_t col, size_t count, std::complex<T>* out) {
+        for (size_t r = 0; r < rows; ++r) {
+            const std::complex<T>* row = m + r * cols + col;
+            for (size_t c = 0; c < count; ++c) {
+                out[c * rows + r] = row[c];
+            }
+        }
+    }
+
+    /// Inverse of gather().
+    template<typename T>
+    void scatter(const std::complex<T>* in, size_t rows, size_t cols,
+                 size_t col, size_t count, std::complex<T>* m) {
+        for (size_t r = 0; r < rows; ++r) {
+            std::complex<T>* row = m + r * cols + col;
+            for (size_t c = 0; c < count; ++c) {
+                row[c] = in[c * rows + r];
+            }
+        }
+    }
+
+}
+
+#endif
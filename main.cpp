@@ -1,7 +1,10 @@
 // Run with:
-// g++ -o bench -std=c++11 -O3 main.cpp && ./bench
+// g++ -o bench -std=c++11 -O3 -pthread main.cpp && ./bench
 
 #include <array>
+#include <random>
+#include <thread>
+#include <set>
 
 #include "benchtest/benchtest.hpp"
 #include "cxlr.hpp"
@@ -9,10 +12,18 @@
 #include "four1plus.hpp"
 #include "four1tmpl.hpp"
 #include "fft.hpp"
+#include "spectrogram.hpp"
+#include "shmring.hpp"
+#include "fftd.hpp"
+#include "outofcore.hpp"
+#include "sharded.hpp"
+#include "planner.hpp"
+#include "wisdom.hpp"
+#include "testsignal.hpp"
 
-int main() {
-    testing::reporter(new testing::DefaultReporter);
-    return testing::Runner::RunAll();
+int main(int argc, char** argv) {
+    testing::reporter(testing::NewReporter());
+    return testing::Runner::RunAll(argc, argv);
 }
 
 const std::array<std::complex<double>, 8> ref0 {{
@@ -41,13 +52,21 @@ const std::array<std::complex<double>, 8> ref1 {{
 template<typename T>
 class FFTfixture : public testing::Test {
     std::array<std::complex<T>, 8> *test8;
+    TestSignal<T, 8192> signal;
     std::array<std::complex<T>, 8192> *data;
+    std::array<std::complex<T>, 8192> *out;
 protected:
     FFTfixture() :
         test8(new std::array<std::complex<T>, 8>),
-        data(new std::array<std::complex<T>, 8192>) {
+        data(new std::array<std::complex<T>, 8192>),
+        out(new std::array<std::complex<T>, 8192>) {
+        policy.counters = true;
+        policy.cache = testing::Policy::both;
+        Evict(data, sizeof(*data));
+        Evict(out, sizeof(*out));
     }
     ~FFTfixture() {
+        delete out;
         delete data;
         delete test8;
     }
@@ -55,9 +74,7 @@ protected:
         for (size_t i=0; i<8; ++i) {
             (*test8)[i] = ref0[i];
         }
-        for (size_t i=0; i<8192; ++i) {
-            (*data)[i] = ref0[i%8];
-        }
+        *data = *signal;
     }
     void Validate() {
         for (size_t i=0; i<8; ++i) {
@@ -70,7 +87,9 @@ protected:
         ::four1((T*)test8, test8->size());
         ASSERT_NO_FATAL_FAILURE(Validate());
         while (Benchmark()) {
+            signal.refresh(*data, timer);
             ::four1((T*)data, data->size());
+            testing::DoNotOptimize(*data);
         }
     }
 
@@ -78,7 +97,9 @@ protected:
         ::four1plus(*test8);
         ASSERT_NO_FATAL_FAILURE(Validate());
         while (Benchmark()) {
+            signal.refresh(*data, timer);
             ::four1plus(*data);
+            testing::DoNotOptimize(*data);
         }
     }
 
@@ -86,7 +107,9 @@ protected:
         Four1tmpl<std::complex<T>, 8>::fft(*test8);
         ASSERT_NO_FATAL_FAILURE(Validate());
         while (Benchmark()) {
+            signal.refresh(*data, timer);
             Four1tmpl<std::complex<T>, 8192>::fft(*data);
+            testing::DoNotOptimize(*data);
         }
     }
 
@@ -94,7 +117,56 @@ protected:
         FFT::dft(*test8);
         ASSERT_NO_FATAL_FAILURE(Validate());
         while (Benchmark()) {
+            signal.refresh(*data, timer);
             FFT::dft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void outofplace() {
+        auto in8 = *test8;
+        FFT::dft(in8, *test8);
+        ASSERT_NO_FATAL_FAILURE(Validate());
+        while (Benchmark()) {
+            FFT::dft(*data, *out);
+            testing::DoNotOptimize(*out);
+        }
+    }
+
+    // Independent transforms on every core, and at least two threads,
+    // each on its own array.
+    void threads() {
+        unsigned n = std::max(2u, testing::Threads::Cores());
+        std::vector<std::array<std::complex<T>, 8192>> arrays(n);
+        BenchmarkThreads([&](unsigned thread) {
+            signal.refresh(arrays[thread], timer);
+            FFT::dft(arrays[thread]);
+            testing::DoNotOptimize(arrays[thread]);
+        }, n, 0.1);
+    }
+
+    void interleaved() {
+        BenchmarkInterleaved({
+            {"four1tmpl", [this] {
+                signal.refresh(*data, timer);
+                Four1tmpl<std::complex<T>, 8192>::fft(*data);
+                testing::DoNotOptimize(*data);
+            }},
+            {"fft", [this] {
+                signal.refresh(*out, timer);
+                FFT::dft(*out);
+                testing::DoNotOptimize(*out);
+            }}
+        });
+    }
+
+    void hybrid() {
+        FFT::Transform<T, 8, FFT::Hybrid>::dft(*test8);
+        ASSERT_NO_FATAL_FAILURE(Validate());
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            FFT::Transform<T, 8192, FFT::Hybrid>::dft(*data);
+            testing::DoNotOptimize(*data);
         }
     }
 
@@ -104,3 +176,653 @@ TEST_T(FFTfixture, float, four1);
 TEST_T(FFTfixture, float, four1plus);
 TEST_T(FFTfixture, float, four1tmpl);
 TEST_T(FFTfixture, float, fft);
+TEST_T(FFTfixture, float, outofplace);
+TEST_T(FFTfixture, float, hybrid);
+TEST_T(FFTfixture, float, threads);
+TEST_T(FFTfixture, float, interleaved);
+
+TEST(Spectrogram, tile) {
+    const std::string path = std::string(P_tmpdir) + "/fftbench.spec";
+    const Spectrogram::Format formats[] = {
+        Spectrogram::float32, Spectrogram::float16, Spectrogram::decibel8
+    };
+    const float tolerance[] = {0, 1.0f/1024, 0.13f};
+    for (size_t f=0; f<3; ++f) {
+        SCOPED_TRACE() << "format=" << f;
+        {
+            Spectrogram::Writer<64> out(path, formats[f], 50, -20, 1);
+            std::array<std::complex<float>, 64> spectrum;
+            for (size_t t=0; t<600; ++t) {
+                for (size_t i=0; i<64; ++i) {
+                    spectrum[i] = std::complex<float>(i+1, t%7);
+                }
+                out.write(t, spectrum);
+            }
+            ASSERT_TRUE(out.close());
+        }
+        Spectrogram::Reader in(path);
+        ASSERT_TRUE(in.is_open());
+        ASSERT_EQ(600u, in.frames());
+        ASSERT_EQ(64u, in.bins());
+        std::vector<float> tile;
+        std::vector<double> times;
+        ASSERT_EQ(100u, in.tile(150, 250, 10, 20, tile, &times));
+        ASSERT_EQ(1000u, tile.size());
+        for (size_t t=0; t<100; ++t) {
+            ASSERT_EQ(150.0 + t, times[t]);
+            for (size_t i=0; i<10; ++i) {
+                float expected = std::norm(std::complex<float>(i+11, (t+150)%7));
+                ASSERT_NEAR(expected, tile[t*10+i], expected*tolerance[f]);
+            }
+        }
+    }
+    // A chunk count that wraps the index size around must be rejected.
+    Spectrogram::Header h;
+    FILE* file = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_EQ(1u, fread(&h, sizeof(h), 1, file));
+    h.chunks = (0 - h.index_offset) / sizeof(Spectrogram::Chunk);
+    fseek(file, 0, SEEK_SET);
+    ASSERT_EQ(1u, fwrite(&h, sizeof(h), 1, file));
+    fclose(file);
+    Spectrogram::Reader in;
+    ASSERT_FALSE(in.open(path));
+    ASSERT_EQ(0u, in.frames());
+    ASSERT_EQ(0u, in.bins());
+    std::vector<float> tile(1);
+    ASSERT_EQ(0u, in.tile(0, 600, 0, 64, tile));
+    ASSERT_TRUE(tile.empty());
+    ASSERT_EQ(0u, in.seek(10));
+    ASSERT_TRUE(in.frame(0) == nullptr);
+    ASSERT_EQ(0.0, in.time(0));
+    unlink(path.c_str());
+}
+
+TEST(ShmRing, publish) {
+    const std::string name = "/fftbench.ring";
+    ShmRing::Publisher<float, 8> pub(name, 4);
+    ASSERT_TRUE(pub.good());
+    ShmRing::Subscriber<float, 8> sub(name);
+    ASSERT_TRUE(sub.good());
+    ASSERT_FALSE((ShmRing::Subscriber<double, 8>(name).good()));
+    std::array<std::complex<float>, 8> in, out;
+    double time;
+    ASSERT_FALSE(sub.copy(0, time, out));
+    for (size_t f=0; f<10; ++f) {
+        for (size_t i=0; i<8; ++i) {
+            in[i] = ref0[i];
+        }
+        FFT::dft(in, pub.acquire());
+        ASSERT_FALSE(sub.copy(f, time, out));
+        pub.commit(f * 0.5);
+    }
+    ASSERT_EQ(10u, sub.head());
+    ASSERT_FALSE(sub.copy(5, time, out));
+    ASSERT_TRUE(sub.copy(9, time, out));
+    ASSERT_EQ(4.5, time);
+    for (size_t i=0; i<8; ++i) {
+        SCOPED_TRACE() << "i=" << i;
+        ASSERT_EQ(std::complex<float>(ref1[i]), out[i]);
+    }
+}
+
+// Load generator for the FFT service: throughput versus latency.
+static void ServiceLoad(const std::string& path, Service::Server<10>& server) {
+    {
+        // A client that never finishes its handshake must not stall the others.
+        sockaddr_un addr;
+        ASSERT_TRUE(Service::address(path, addr));
+        int silent = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_EQ(0, ::connect(silent, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        Service::Client client(path, 8 * sizeof(std::complex<double>));
+        ASSERT_TRUE(client.good());
+        for (size_t i=0; i<8; ++i) {
+            client.buffer<double>()[i] = ref0[i];
+        }
+        ASSERT_TRUE(client.dft<double>(0, 8));
+        for (size_t i=0; i<8; ++i) {
+            SCOPED_TRACE() << "i=" << i;
+            ASSERT_EQ(ref1[i], client.buffer<double>()[i]);
+        }
+        ASSERT_FALSE(client.dft<double>(8, 8));
+        ASSERT_FALSE(client.dft<double>(0, 6));
+        ASSERT_FALSE(client.dft<double>(4, 4));
+        ::close(silent);
+    }
+    std::ostringstream table;
+    table << "clients   requests/s    p50 us    p99 us   batch";
+    for (size_t clients=1; clients<=16; clients*=2) {
+        std::vector<std::vector<double>> latency(clients);
+        std::vector<std::thread> threads;
+        auto batches = server.batches();
+        auto requests = server.requests();
+        auto start = std::chrono::steady_clock::now();
+        auto stop = start + std::chrono::milliseconds(50);
+        for (size_t c=0; c<clients; ++c) {
+            threads.push_back(std::thread([&, c]() {
+                Service::Client client(path, 1024 * sizeof(std::complex<float>));
+                if (!client.good()) return;
+                for (size_t i=0; i<1024; ++i) {
+                    client.buffer<float>()[i] = ref0[i%8];
+                }
+                while (std::chrono::steady_clock::now() < stop) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    if (!client.dft<float>(0, 1024)) return;
+                    auto t1 = std::chrono::steady_clock::now();
+                    latency[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                }
+            }));
+        }
+        for (auto& t : threads) t.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::vector<double> all;
+        for (auto& l : latency) all.insert(all.end(), l.begin(), l.end());
+        ASSERT_FALSE(all.empty());
+        std::sort(all.begin(), all.end());
+        double batch = double(server.requests() - requests) / (server.batches() - batches);
+        table << std::endl << std::setw(7) << clients
+              << std::setw(13) << std::fixed << std::setprecision(0) << all.size() / seconds
+              << std::setw(10) << std::setprecision(1) << all[all.size() / 2]
+              << std::setw(10) << all[all.size() * 99 / 100]
+              << std::setw(8) << batch;
+    }
+    testing::reporter()->Print(table.str());
+}
+
+TEST(Service, load) {
+    const std::string path = std::string(P_tmpdir) + "/fftbench.sock";
+    Service::Server<10> server(path);
+    ASSERT_TRUE(server.good());
+    std::thread serve([&]() { server.run(); });
+    EXPECT_NO_FATAL_FAILURE(ServiceLoad(path, server));
+    server.stop();
+    serve.join();
+}
+
+TEST(OutOfCore, dft) {
+    const std::string in = std::string(P_tmpdir) + "/fftbench.in";
+    const std::string out = std::string(P_tmpdir) + "/fftbench.out";
+    auto data = new std::array<std::complex<double>, 8192>;
+    std::minstd_rand rand;
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    for (auto& x : *data) {
+        x = std::complex<double>(uniform(rand), uniform(rand));
+    }
+    FILE* f = fopen(in.c_str(), "wb");
+    ASSERT_TRUE(f != nullptr);
+    fwrite(data->data(), sizeof(*data), 1, f);
+    fclose(f);
+    FFT::dft(*data);
+    // Small memory budget forces many blocks in both passes.
+    ASSERT_TRUE((OutOfCore::dft<double, 64, 128>(in, out, 64 << 10)));
+    OutOfCore::Mapping result(out, sizeof(*data), false);
+    ASSERT_TRUE(result.good());
+    for (size_t i=0; i<8192; ++i) {
+        SCOPED_TRACE() << "i=" << i;
+        ASSERT_NEAR(0, std::abs((*data)[i] - result.data<std::complex<double>>()[i]), 1e-10);
+    }
+    delete data;
+    unlink(in.c_str());
+    unlink(out.c_str());
+}
+
+TEST(OutOfCore, throughput) {
+    const std::string in = std::string(P_tmpdir) + "/fftbench.in";
+    const std::string out = std::string(P_tmpdir) + "/fftbench.out";
+    typedef std::array<std::complex<float>, 1 << 21> Array;
+    TestSignal<float, 1 << 21> signal;
+    const Array& input = *signal;
+    {
+        OutOfCore::Mapping m(in, sizeof(Array), true);
+        ASSERT_TRUE(m.good());
+        std::copy(input.begin(), input.end(), m.data<std::complex<float>>());
+    }
+    // Each pass reads the whole input file and rewrites the output file.
+    policy.max_time = 1;
+    while (Benchmark()) {
+        ASSERT_TRUE((OutOfCore::dft<float, 1024, 2048>(in, out, 4 << 20)));
+    }
+    auto expect = new Array(input);
+    FFT::dft(*expect);
+    {
+        // A quarter of the data as working memory still gives the whole transform.
+        OutOfCore::Mapping m(out, sizeof(Array), false);
+        ASSERT_TRUE(m.good());
+        auto data = m.data<std::complex<float>>();
+        for (size_t i=0; i<expect->size(); ++i) {
+            SCOPED_TRACE() << "i=" << i;
+            ASSERT_NEAR(0, std::abs((*expect)[i] - data[i]), 1e-2);
+        }
+    }
+    delete expect;
+    unlink(in.c_str());
+    unlink(out.c_str());
+}
+
+TEST(Sharded, dft) {
+    auto data = new std::array<std::complex<double>, 8192>;
+    std::minstd_rand rand;
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    for (auto& x : *data) {
+        x = std::complex<double>(uniform(rand), uniform(rand));
+    }
+    Sharded::Transform<double, 64, 128> sharded(4);
+    ASSERT_TRUE(sharded.good());
+    std::copy(data->begin(), data->end(), sharded.data());
+    ASSERT_TRUE(sharded.dft());
+    FFT::dft(*data);
+    for (size_t i=0; i<8192; ++i) {
+        SCOPED_TRACE() << "i=" << i;
+        ASSERT_NEAR(0, std::abs((*data)[i] - sharded.data()[i]), 1e-10);
+    }
+    ASSERT_TRUE(sharded.idft());
+    FFT::idft(*data);
+    for (size_t i=0; i<8192; ++i) {
+        SCOPED_TRACE() << "i=" << i;
+        ASSERT_NEAR(0, std::abs((*data)[i] - sharded.data()[i]), 1e-7);
+    }
+    ASSERT_FALSE((Sharded::Transform<double, 64, 128>(3).good()));
+    // A lost worker fails the transform instead of hanging it.
+    ASSERT_EQ(3u, sharded.pids().size());
+    ASSERT_EQ(0, kill(sharded.pids()[1], SIGKILL));
+    ASSERT_FALSE(sharded.dft());
+    ASSERT_FALSE(sharded.good());
+    ASSERT_FALSE(sharded.idft());
+    delete data;
+}
+
+TEST(Planner, dft) {
+    typedef Plan::Planner<float, 8> P8;
+    std::array<std::complex<float>, 8> in, out;
+    for (size_t i=0; i<8; ++i) {
+        in[i] = ref0[i];
+    }
+    P8::dft(in, out);
+    P8::dft(in);
+    for (size_t i=0; i<8; ++i) {
+        SCOPED_TRACE() << "i=" << i;
+        ASSERT_EQ(std::complex<float>(ref1[i]), in[i]);
+        ASSERT_EQ(std::complex<float>(ref1[i]), out[i]);
+    }
+    auto& decision = Plan::decisions()[Plan::key("float", 8, Plan::inplace)];
+    ASSERT_EQ(5u, decision.timings.size());
+    ASSERT_EQ(decision.kernel, P8::kernel(Plan::inplace));
+    // Each size keeps every timing and dispatches to the fastest.
+    for (auto layout : {Plan::inplace, Plan::outofplace}) {
+        SCOPED_TRACE() << Plan::key("float", 8192, layout);
+        auto kernel = Plan::Planner<float, 8192>::kernel(layout);
+        auto& timings = Plan::decisions()[Plan::key("float", 8192, layout)].timings;
+        ASSERT_FALSE(timings.empty());
+        auto fastest = std::min_element(timings.begin(), timings.end(),
+            [](const std::pair<std::string, double>& a, const std::pair<std::string, double>& b) {
+                return a.second < b.second;
+            });
+        ASSERT_EQ(fastest->first, kernel);
+    }
+}
+
+TEST(Wisdom, save) {
+    const std::string path = std::string(P_tmpdir) + "/fftbench.wisdom";
+    Plan::Planner<double, 16>::tune(20);
+    auto key = Plan::key("double", 16, Plan::outofplace);
+    auto saved = Plan::decisions()[key];
+    ASSERT_TRUE(Wisdom::save(path));
+    Plan::decisions().erase(key);
+    ASSERT_TRUE(Wisdom::load(path));
+    auto& loaded = Plan::decisions()[key];
+    ASSERT_EQ(saved.kernel, loaded.kernel);
+    ASSERT_EQ(saved.timings.size(), loaded.timings.size());
+    for (size_t i=0; i<saved.timings.size(); ++i) {
+        ASSERT_EQ(saved.timings[i].first, loaded.timings[i].first);
+        ASSERT_EQ(saved.timings[i].second, loaded.timings[i].second);
+    }
+    // Wisdom from other hardware is ignored.
+    FILE* f = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(f != nullptr);
+    fseek(f, offsetof(Wisdom::Header, hash), SEEK_SET);
+    int byte = fgetc(f);
+    ASSERT_NE(EOF, byte);
+    fseek(f, offsetof(Wisdom::Header, hash), SEEK_SET);
+    fputc(~byte & 0xff, f);
+    fclose(f);
+    Plan::decisions().erase(key);
+    ASSERT_FALSE(Wisdom::load(path));
+    ASSERT_EQ(0u, Plan::decisions().count(key));
+    ASSERT_FALSE(Wisdom::load(path + ".missing"));
+    unlink(path.c_str());
+}
+
+template<template<typename, int, size_t> class M, size_t N>
+static void MixerMatches() {
+    auto a = new std::array<std::complex<double>, N>;
+    auto b = new std::array<std::complex<double>, N>;
+    std::minstd_rand rand;
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    for (auto& x : *a) {
+        x = std::complex<double>(uniform(rand), uniform(rand));
+    }
+    FFT::Transform<double, N, M>::dft(*a, *b);
+    FFT::dft(*a);
+    for (size_t i=0; i<N; ++i) {
+        SCOPED_TRACE() << "N=" << N << " i=" << i;
+        ASSERT_NEAR(0, std::abs((*a)[i] - (*b)[i]), 1e-12);
+    }
+    FFT::Transform<double, N, M>::idft(*b);
+    FFT::idft(*a);
+    for (size_t i=0; i<N; ++i) {
+        SCOPED_TRACE() << "N=" << N << " i=" << i;
+        ASSERT_NEAR(0, std::abs((*a)[i] - (*b)[i]), 1e-9);
+    }
+    delete b;
+    delete a;
+}
+
+TEST(Hybrid, matches) {
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Hybrid, 256>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Hybrid, 1024>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Hybrid, 2048>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Hybrid, 8192>()));
+}
+
+TEST(BreadthFirst, matches) {
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::BreadthFirst, 8>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::BreadthFirst, 64>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::BreadthFirst, 512>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::BreadthFirst, 8192>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Auto, 16>()));
+    ASSERT_NO_FATAL_FAILURE((MixerMatches<FFT::Auto, 64>()));
+}
+
+TEST(Sampler, policy) {
+    typedef std::chrono::steady_clock clock;
+    testing::Policy p;
+    p.min_time = 0.02;
+    testing::Sampler s1;
+    auto start = clock::now();
+    while (s1.Next(10, p)) {}
+    ASSERT_LE(0.02, std::chrono::duration<double>(clock::now() - start).count());
+    ASSERT_LT(10u, s1.Iterations());
+    p = testing::Policy();
+    p.max_time = 0.01;
+    testing::Sampler s2;
+    start = clock::now();
+    while (s2.Next(1000000, p)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    ASSERT_GT(0.5, std::chrono::duration<double>(clock::now() - start).count());
+    // The cap also ends calibration of a batch that can't reach sample_time.
+    p = testing::Policy();
+    p.sample_time = 10;
+    p.max_time = 0.01;
+    testing::Sampler s4;
+    start = clock::now();
+    while (s4.Next(20, p)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    ASSERT_GT(0.5, std::chrono::duration<double>(clock::now() - start).count());
+    p = testing::Policy();
+    p.ci_width = 0.5;
+    testing::Sampler s3;
+    while (s3.Next(1000000, p)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    ASSERT_GT(1000u, s3.Iterations());
+    auto stats = s3.Statistics();
+    ASSERT_LE(stats.ci_low, stats.median);
+    ASSERT_GE(stats.ci_high, stats.median);
+}
+
+TEST(Sampler, batch) {
+    testing::Policy p;
+    p.sample_time = 1e-3;
+    testing::Sampler s;
+    unsigned long passes = 0;
+    while (s.Next(20, p)) ++passes;
+    ASSERT_LT(1000u, s.Batch());
+    ASSERT_LE(s.Iterations() * s.Batch(), passes);
+    ASSERT_GT(0.01, s.Statistics().median);
+}
+
+TEST(Sampler, pause) {
+    testing::Sampler s;
+    while (s.Next(20)) {
+        s.Pause();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        s.Resume();
+    }
+    ASSERT_EQ(1u, s.Batch());
+    ASSERT_GT(50.0, s.Statistics().median);
+}
+
+TEST(Sampler, cold) {
+    std::vector<char> buffer(1 << 16);
+    testing::Policy p;
+    p.cache = testing::Policy::cold;
+    testing::Sampler s;
+    s.Evict(buffer.data(), buffer.size());
+    while (s.Next(20, p)) {
+        for (size_t i=0; i<buffer.size(); i+=64) ++buffer[i];
+        testing::ClobberMemory();
+    }
+    auto stats = s.Statistics();
+    ASSERT_EQ(1u, stats.batch);
+    ASSERT_EQ(std::string("cold"), stats.cache);
+}
+
+TEST(Optimize, large) {
+    // Larger than the usual 8 MiB stack, so it must not be copied there.
+    auto big = new std::array<char, 16 << 20>();
+    testing::DoNotOptimize(*big);
+    const std::array<char, 16 << 20>& view = *big;
+    testing::DoNotOptimize(view);
+    ASSERT_EQ(0, (*big)[0]);
+    delete big;
+}
+
+TEST(Tsc, calibrate) {
+    if (!testing::Tsc::Available()) {
+        testing::reporter()->Print("Invariant TSC not available, using the system clock.");
+        return;
+    }
+    ASSERT_LT(1e8, testing::Tsc::Hz());
+    ASSERT_GT(1e11, testing::Tsc::Hz());
+    uint64_t t0 = testing::Tsc::Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t t1 = testing::Tsc::Stop();
+    ASSERT_LE(testing::Tsc::Hz() / 1000, double(t1 - t0));
+}
+
+TEST(Counters, read) {
+    testing::Counters counters;
+    std::vector<uint64_t> before, after;
+    counters.Read(before);
+    // Larger than the malloc mmap threshold so every page is new.
+    std::vector<char> touch(64 << 20, 1);
+    testing::DoNotOptimize(touch.data());
+    counters.Read(after);
+    const size_t n = counters.Names().size();
+    ASSERT_EQ(3 * n, before.size());
+    ASSERT_EQ(before.size(), after.size());
+    std::vector<double> delta(after.size());
+    const std::set<std::string> known {"instructions", "cycles", "branch-misses", "cache-misses",
+                                        "dTLB-misses", "page-faults", "context-switches"};
+    for (size_t i=0; i<n; ++i) {
+        std::string name = counters.Names()[i];
+        SCOPED_TRACE() << name;
+        ASSERT_EQ(1u, known.count(name));
+        for (size_t k=i; k<3*n; k+=n) {
+            ASSERT_LE(before[k], after[k]);
+            delta[k] = after[k] - before[k];
+        }
+        double count = 0;
+        if (name == "page-faults" && counters.Scale(delta, i, count)) {
+            EXPECT_GE(count, 1);
+        }
+    }
+}
+
+TEST(Reporter, formats) {
+    testing::Stats stats;
+    stats.iterations = 10;
+    stats.median = 1.5;
+    stats.counters.push_back(std::make_pair("page-faults", 0.25));
+    testing::ThreadStats threads;
+    threads.threads = 2;
+    threads.rate = 1000;
+    std::ostringstream json, csv, text;
+    std::unique_ptr<testing::Reporter> reporters[] = {
+        std::unique_ptr<testing::Reporter>(new testing::JsonReporter(json, text)),
+        std::unique_ptr<testing::Reporter>(new testing::CsvReporter(csv, text))
+    };
+    for (auto& r : reporters) {
+        r->test_info = testing::reporter()->test_info;
+        r->Start(1, 1);
+        r->Bench(stats);
+        r->Threads(threads);
+        r->End(0);
+    }
+    auto j = json.str();
+    EXPECT_NE(std::string::npos, j.find("\"name\": \"Reporter.formats\", \"case\": \"Reporter\", \"test\": \"formats\""));
+    EXPECT_NE(std::string::npos, j.find("\"median\": 1.5"));
+    EXPECT_NE(std::string::npos, j.find("\"counters\": {\"page-faults\": 0.25}"));
+    EXPECT_NE(std::string::npos, j.find("\"threads\": 2"));
+    EXPECT_NE(std::string::npos, j.find("\"compiler\": "));
+    EXPECT_EQ(std::string::npos, j.find("\"size\": "));
+    auto c = csv.str();
+    EXPECT_NE(std::string::npos, c.find("\nReporter.formats,Reporter,formats,,,,10,1,0,1.5,"));
+    EXPECT_NE(std::string::npos, c.find(",page-faults=0.25,"));
+    EXPECT_NE(std::string::npos, c.find("\nReporter.formats,Reporter,formats,,,,,,,,,,,,,,,,,2,"));
+}
+
+TEST(Baseline, regression) {
+    std::minstd_rand rand;
+    std::normal_distribution<double> noise(0, 1);
+    std::vector<double> before, same, slower;
+    for (int i = 0; i < 50; ++i) {
+        before.push_back(100 + noise(rand));
+        same.push_back(100 + noise(rand));
+        slower.push_back(110 + noise(rand));
+    }
+    EXPECT_GT(testing::Baseline::MannWhitney(same, before), 0.01);
+    EXPECT_LT(testing::Baseline::MannWhitney(slower, before), 1e-6);
+    EXPECT_GT(testing::Baseline::MannWhitney(before, slower), 0.99);
+
+    const std::string path = std::string(P_tmpdir) + "/fftbench.baseline";
+    testing::Baseline saved;
+    testing::Stats stats;
+    saved.Add("A<long double>.b", before, stats);
+    ASSERT_TRUE(saved.Save(path));
+    testing::Baseline base;
+    ASSERT_TRUE(base.Load(path));
+    // A malformed file leaves what was loaded before.
+    std::ofstream(path) << "benchtest baseline 1\nA<long double>.c\t1 2\nbroken\n";
+    ASSERT_FALSE(base.Load(path));
+    std::remove(path.c_str());
+    stats.median = 100;
+    base.Add("A<long double>.b", same, stats);
+    EXPECT_NEAR(100, stats.baseline_median, 1);
+    EXPECT_FALSE(stats.regression);
+    stats.median = 110;
+    base.Add("A<long double>.b", slower, stats);
+    EXPECT_TRUE(stats.regression);
+    EXPECT_EQ(1ul, base.regressions);
+    testing::Stats other;
+    base.Add("A<long double>.c", slower, other);
+    EXPECT_EQ(0, other.baseline_median);
+}
+
+TEST(Runner, filter) {
+    EXPECT_TRUE(testing::Runner::Filter("*", "FFTfixture<float>.four1"));
+    EXPECT_TRUE(testing::Runner::Filter("FFTfixture*", "FFTfixture<float>.four1"));
+    EXPECT_TRUE(testing::Runner::Filter("*.fft:*.four1", "FFTfixture<float>.four1"));
+    EXPECT_FALSE(testing::Runner::Filter("*.fft", "FFTfixture<float>.four1"));
+    EXPECT_TRUE(testing::Runner::Filter("*.four?", "FFTfixture<float>.four1"));
+    EXPECT_FALSE(testing::Runner::Filter("*.four?", "FFTfixture<float>.four1plus"));
+    EXPECT_FALSE(testing::Runner::Filter("FFT*-*.four1", "FFTfixture<float>.four1"));
+    EXPECT_TRUE(testing::Runner::Filter("-*.four1", "FFTfixture<float>.four1plus"));
+}
+
+TEST(Runner, options) {
+    std::ostringstream out, err;
+    auto cout = std::cout.rdbuf(out.rdbuf());
+    auto cerr = std::cerr.rdbuf(err.rdbuf());
+    for (auto arg : {"--repeat=abc", "--repeat=0", "--benchmark_min_time=x", "--pin=-1", "--warmup=1s"}) {
+        SCOPED_TRACE() << arg;
+        std::string a = arg;
+        char* argv[] = {const_cast<char*>("bench"), &a[0]};
+        EXPECT_EQ(EXIT_FAILURE, testing::Runner::RunAll(2, argv));
+    }
+    std::cout.rdbuf(cout);
+    std::cerr.rdbuf(cerr);
+    EXPECT_NE(std::string::npos, err.str().find("Invalid value in --repeat=abc"));
+}
+
+TEST(Channel, roundtrip) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    testing::Channel out(fds[1]), in(fds[0]);
+    ASSERT_TRUE(out.Put(testing::Channel::print).Put(std::string("FFT<float>")).Put(1.5).Put(uint64_t(42)).Send());
+    close(fds[1]);
+    testing::Channel::Message m;
+    std::string s;
+    double d = 0;
+    uint64_t u = 0;
+    ASSERT_TRUE(in.Get(m));
+    EXPECT_EQ(testing::Channel::print, m);
+    ASSERT_TRUE(in.Get(s));
+    EXPECT_EQ("FFT<float>", s);
+    ASSERT_TRUE(in.Get(d));
+    EXPECT_EQ(1.5, d);
+    ASSERT_TRUE(in.Get(u));
+    EXPECT_EQ(42u, u);
+    EXPECT_FALSE(in.Get(m));
+    close(fds[0]);
+}
+
+TEST(Interleave, ratio) {
+    std::vector<float> v(4096, 1);
+    auto sum = [&v](int times) {
+        float s = 0;
+        for (int t = 0; t < times; ++t) {
+            for (auto x : v) s += x;
+            testing::DoNotOptimize(s);
+        }
+    };
+    testing::Interleave ab({
+        {"once", [&] { sum(1); }},
+        {"twice", [&] { sum(2); }}
+    });
+    auto result = ab.Run(30);
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ("twice", result[1].name);
+    EXPECT_EQ(30ul, result[1].stats.iterations);
+    EXPECT_EQ(1, result[0].ratio);
+    EXPECT_GT(result[1].ratio, 1);
+    EXPECT_LE(result[1].ratio_low, result[1].ratio);
+    EXPECT_GE(result[1].ratio_high, result[1].ratio);
+    // Paused setup is left out of each body's time.
+    testing::Interleave* paused = nullptr;
+    auto setup = [&paused] {
+        paused->Pause();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        paused->Resume();
+    };
+    testing::Interleave cd({
+        {"setup", [&] { setup(); sum(1); }},
+        {"setup twice", [&] { setup(); setup(); sum(1); }}
+    });
+    paused = &cd;
+    result = cd.Run(20);
+    EXPECT_EQ(1ul, result[0].stats.batch);
+    EXPECT_GT(100.0, result[0].stats.median);
+    EXPECT_GT(100.0, result[1].stats.median);
+}
+
+TEST(Threads, pause) {
+    auto stats = testing::Threads::Run(1, 0.05, [](unsigned) {
+        testing::Threads::Pause();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        testing::Threads::Resume();
+    });
+    ASSERT_LT(1e5, stats.rate);
+}
@@ -0,0 +1,159 @@
+// Out-of-core FFT for transforms larger than memory.
+//
+// The input file holds N1*N2 std::complex<T> values. It is memory mapped
+// and processed with the four-step decomposition (see fourstep.hpp) in
+// two passes over blocks of columns, so only a block of N1 or N2 point
+// vectors is resident at a time:
+//
+//  1. Gather a block of input columns, run N1-point transforms, apply
+//     the twiddles and write the block as contiguous rows of the output.
+//  2. Gather a block of output columns, run N2-point transforms and
+//     scatter them back in place. The output is now in natural order.
+//
+// While one block is being transformed, the next block is gathered on
+// another thread, which overlaps page faults and reads with compute.
+//
+// Example usage, 2^32 points:
+//
+//     OutOfCore::dft<float, 65536, 65536>("capture.raw", "spectrum.raw");
+
+#ifndef fftbench_outofcore_hpp
+#define fftbench_outofcore_hpp
+
+#include <algorithm>
+#include <complex>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fourstep.hpp"
+
+namespace OutOfCore {
+
+    // A whole file mapped into memory.
+    class Mapping {
+        void* base = MAP_FAILED;
+        size_t length = 0;
+    public:
+        Mapping(const std::string& path, size_t length, bool create) : length(length) {
+            int fd = create ? ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)
+                            : ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            bool ok = create ? ::ftruncate(fd, length) == 0
+                             : ::fstat(fd, &st) == 0 && size_t(st.st_size) == length;
+            if (ok) {
+                base = ::mmap(nullptr, length, create ? PROT_READ | PROT_WRITE : PROT_READ,
+                              MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+        }
+        ~Mapping() {
+            if (good()) ::munmap(base, length);
+        }
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        bool good() const {
+            return base != MAP_FAILED;
+        }
+        template<typename T>
+        T* data() const {
+            return static_cast<T*>(base);
+        }
+        bool sync() {
+            return ::msync(base, length, MS_SYNC) == 0;
+        }
+    };
+
+    template<typename T, int D, size_t N1, size_t N2>
+    class Passes {
+        static_assert(N1 > 1 && N2 > 1, "Both factors must be transform sizes.");
+        typedef std::complex<T> C;
+
+        // Gather, transform and scatter blocks of columns of a rows x cols matrix.
+        // The transform runs while the following block is gathered.
+        template<typename Gather, typename Work>
+        static void blocks(size_t rows, size_t cols, size_t block, Gather gather, Work work) {
+            std::vector<C> current(block * rows), next(block * rows);
+            size_t count = std::min(block, cols);
+            gather(0, count, current.data());
+            for (size_t col = 0; col < cols; col += block) {
+                size_t next_col = col + block;
+                size_t next_count = next_col < cols ? std::min(block, cols - next_col) : 0;
+                std::future<void> prefetch;
+                if (next_count) {
+                    C* p = next.data();
+                    prefetch = std::async(std::launch::async, [=]() {
+                        gather(next_col, next_count, p);
+                    });
+                }
+                work(col, count, current.data());
+                if (next_count) prefetch.get();
+                current.swap(next);
+                count = next_count;
+            }
+        }
+
+        static size_t block_size(size_t rows, size_t cols, size_t memory) {
+            size_t block = memory / (2 * rows * sizeof(C));
+            if (block < 1) block = 1;
+            if (block > cols) block = cols;
+            return block;
+        }
+
+    public:
+        static bool run(const std::string& in_path, const std::string& out_path, size_t memory) {
+            const size_t bytes = N1 * N2 * sizeof(C);
+            Mapping in(in_path, bytes, false);
+            if (!in.good()) return false;
+            Mapping out(out_path, bytes, true);
+            if (!out.good()) return false;
+            const C* x = in.data<C>();
+            C* y = out.data<C>();
+
+            // Pass 1: columns of x[n1][n2] become rows of y[n2][k1].
+            blocks(N1, N2, block_size(N1, N2, memory), [=](size_t col, size_t count, C* buf) {
+                FourStep::gather(x, N1, N2, col, count, buf);
+            }, [=](size_t col, size_t count, C* buf) {
+                for (size_t c = 0; c < count; ++c) {
+                    FourStep::transform<T, D, N1>(buf + c * N1);
+                    FourStep::twiddle<T, D>(buf + c * N1, N1, col + c, uint64_t(N1) * N2);
+                }
+                std::copy(buf, buf + count * N1, y + col * N1);
+            });
+
+            // Pass 2: columns of y[n2][k1] become y[k2][k1], which is X[k1 + N1*k2].
+            blocks(N2, N1, block_size(N2, N1, memory), [=](size_t col, size_t count, C* buf) {
+                FourStep::gather(static_cast<const C*>(y), N2, N1, col, count, buf);
+            }, [=](size_t col, size_t count, C* buf) {
+                for (size_t c = 0; c < count; ++c) {
+                    FourStep::transform<T, D, N2>(buf + c * N2);
+                }
+                FourStep::scatter(static_cast<const C*>(buf), N2, N1, col, count, y);
+            });
+            return out.sync();
+        }
+    };
+
+    /// Discrete Fourier transform of the N1*N2 points in file in,
+    /// written to file out. Uses about memory bytes of buffers.
+    template<typename T, size_t N1, size_t N2>
+    inline bool dft(const std::string& in, const std::string& out, size_t memory = size_t(256) << 20) {
+        return Passes<T, -1, N1, N2>::run(in, out, memory);
+    }
+
+    /// Inverse discrete Fourier transform of the N1*N2 points in file in,
+    /// written to file out. Uses about memory bytes of buffers.
+    template<typename T, size_t N1, size_t N2>
+    inline bool idft(const std::string& in, const std::string& out, size_t memory = size_t(256) << 20) {
+        return Passes<T, 1, N1, N2>::run(in, out, memory);
+    }
+
+}
+
+#endif
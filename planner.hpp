@@ -0,0 +1,226 @@
+// Auto-tuning planner that picks the fastest transform for each size.
+//
+// Every implementation in this repository is registered as a candidate.
+// The first time a size is used, or when tune() is called, each candidate
+// is timed with the benchtest Sampler for the in-place and out-of-place
+// layouts and the winners are stored in a dispatch table. Both the
+// depth-first and breadth-first traversals of fft.hpp are candidates, so
+// the planner also finds the best traversal for each size. Candidates
+// without an out-of-place form are timed as a copy plus in-place call.
+//
+// All decisions, with the timings they were based on, are also kept in
+// Plan::decisions() so they can be inspected, saved and restored.
+//
+// Example usage:
+//
+//     std::array<std::complex<float>, 4096> data;
+//     Plan::Planner<float, 4096>::dft(data);
+//
+// More candidates can be added before first use:
+//
+//     Plan::Planner<float, 4096>::add("mine", my_dft);
+//
+// Planning is not thread safe. Plan or tune each size before sharing it.
+
+#ifndef fftbench_planner_hpp
+#define fftbench_planner_hpp
+
+#include <array>
+#include <complex>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchtest/benchtest.hpp"
+#include "four1.hpp"
+#include "four1plus.hpp"
+#include "four1tmpl.hpp"
+#include "fft.hpp"
+#include "testsignal.hpp"
+
+namespace Plan {
+
+    enum Layout {
+        inplace = 0,
+        outofplace = 1
+    };
+
+    template<typename T> struct TypeName;
+    template<> struct TypeName<float> { static const char* name() { return "float"; } };
+    template<> struct TypeName<double> { static const char* name() { return "double"; } };
+    template<> struct TypeName<long double> { static const char* name() { return "long double"; } };
+
+    /// The kernel chosen for one type, size and layout,
+    /// with the time in microseconds of every candidate.
+    struct Decision {
+        std::string kernel;
+        std::vector<std::pair<std::string, double>> timings;
+    };
+
+    inline std::string key(const std::string& type, size_t n, Layout layout) {
+        return type + "/" + std::to_string(n) + (layout == inplace ? "/inplace" : "/outofplace");
+    }
+
+    /// Every decision made or loaded, by key().
+    inline std::map<std::string, Decision>& decisions() {
+        static std::map<std::string, Decision> d;
+        return d;
+    }
+
+    template<typename T, size_t N>
+    class Planner {
+    public:
+        typedef std::array<std::complex<T>, N> Array;
+        typedef void (*InPlace)(Array&);
+        typedef void (*OutOfPlace)(const Array&, Array&);
+        struct Candidate {
+            std::string name;
+            InPlace in;
+            OutOfPlace out;
+        };
+
+    private:
+        template<InPlace F>
+        static void copied(const Array& in, Array& out) {
+            out = in;
+            F(out);
+        }
+
+        static void four1(Array& a) {
+            ::four1(reinterpret_cast<T*>(a.data()), N);
+        }
+        static void four1plus(Array& a) {
+            ::four1plus(a);
+        }
+        static void four1tmpl(Array& a) {
+            Four1tmpl<std::complex<T>, N>::fft(a);
+        }
+        static void fft(Array& a) {
+            FFT::Transform<T, N>::dft(a);
+        }
+        static void fft(const Array& in, Array& out) {
+            FFT::Transform<T, N>::dft(in, out);
+        }
+        static void breadthfirst(Array& a) {
+            FFT::Transform<T, N, FFT::BreadthFirst>::dft(a);
+        }
+        static void breadthfirst(const Array& in, Array& out) {
+            FFT::Transform<T, N, FFT::BreadthFirst>::dft(in, out);
+        }
+
+        static std::vector<Candidate>& candidates() {
+            static std::vector<Candidate> c {
+                {"four1", four1, copied<four1>},
+                {"four1plus", four1plus, copied<four1plus>},
+                {"four1tmpl", four1tmpl, copied<four1tmpl>},
+                {"fft", fft, fft},
+                {"breadthfirst", breadthfirst, breadthfirst}
+            };
+            return c;
+        }
+
+        static InPlace& in_kernel() {
+            static InPlace k = nullptr;
+            return k;
+        }
+        static OutOfPlace& out_kernel() {
+            static OutOfPlace k = nullptr;
+            return k;
+        }
+
+        static const Candidate* find(const std::string& name) {
+            for (auto& c : candidates()) {
+                if (c.name == name) return &c;
+            }
+            return nullptr;
+        }
+
+        // Use a decision made earlier or loaded from storage if possible.
+        static bool recall() {
+            auto& d = decisions();
+            auto in = d.find(key(TypeName<T>::name(), N, inplace));
+            auto out = d.find(key(TypeName<T>::name(), N, outofplace));
+            if (in == d.end() || out == d.end()) return false;
+            auto cin = find(in->second.kernel);
+            auto cout = find(out->second.kernel);
+            if (!cin || !cout || !cout->out) return false;
+            in_kernel() = cin->in;
+            out_kernel() = cout->out;
+            return true;
+        }
+
+        static void plan() {
+            if (!recall()) tune();
+        }
+
+    public:
+        /// Register another candidate. Clears any earlier decision.
+        static void add(const std::string& name, InPlace in, OutOfPlace out = nullptr) {
+            candidates().push_back(Candidate{name, in, out});
+            decisions().erase(key(TypeName<T>::name(), N, inplace));
+            decisions().erase(key(TypeName<T>::name(), N, outofplace));
+            in_kernel() = nullptr;
+            out_kernel() = nullptr;
+        }
+
+        /// Time every candidate now and replace the decisions for this size.
+        static void tune(unsigned long max = 100) {
+            TestSignal<T, N> signal;
+            Array* in = new Array();
+            Array* out = new Array();
+            Decision din, dout;
+            double best_in = 0, best_out = 0;
+            for (auto& c : candidates()) {
+                testing::Sampler s;
+                while (s.Next(max)) {
+                    signal.refresh(*in, s);
+                    c.in(*in);
+                }
+                double us = s.Mean();
+                din.timings.push_back(std::make_pair(c.name, us));
+                if (din.kernel.empty() || us < best_in) {
+                    best_in = us;
+                    din.kernel = c.name;
+                    in_kernel() = c.in;
+                }
+                if (!c.out) continue;
+                testing::Sampler so;
+                while (so.Next(max)) c.out(*signal, *out);
+                us = so.Mean();
+                dout.timings.push_back(std::make_pair(c.name, us));
+                if (dout.kernel.empty() || us < best_out) {
+                    best_out = us;
+                    dout.kernel = c.name;
+                    out_kernel() = c.out;
+                }
+            }
+            delete out;
+            delete in;
+            decisions()[key(TypeName<T>::name(), N, inplace)] = din;
+            decisions()[key(TypeName<T>::name(), N, outofplace)] = dout;
+        }
+
+        /// Discrete Fourier transform with the fastest kernel.
+        static void dft(Array& data) {
+            if (!in_kernel()) plan();
+            in_kernel()(data);
+        }
+
+        /// Discrete Fourier transform with the fastest kernel.
+        static void dft(const Array& in, Array& out) {
+            if (!out_kernel()) plan();
+            out_kernel()(in, out);
+        }
+
+        /// Name of the kernel in use, planning first if needed.
+        static const std::string& kernel(Layout layout) {
+            if (!in_kernel() || !out_kernel()) plan();
+            return decisions()[key(TypeName<T>::name(), N, layout)].kernel;
+        }
+    };
+
+}
+
+#endif
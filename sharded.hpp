@@ -0,0 +1,340 @@
+// Multi-process sharded FFT over shared memory.
+//
+// The N1*N2 points live in one shared memory segment split into equal
+// slabs, one for each rank. Rank 0 is the calling process and the other
+// ranks are forked worker processes that stay alive between transforms.
+// Each rank transforms only its own slab with FFT::Transform and the
+// ranks cooperate on the global transposes of the four-step algorithm
+// (see fourstep.hpp) through Comm::alltoall, which has the semantics of
+// MPI_Alltoall so the same schedule can later run over a network.
+//
+// Pages of each slab and each rank's scratch buffers are first touched
+// by the rank that uses them, so on NUMA hosts they are local to it.
+// On Linux the workers are killed when the thread that constructed the
+// Transform exits, so construct it on a thread that outlives its use.
+// When a worker dies the transform fails and the Transform is no longer
+// good(); the remaining workers are killed rather than left waiting.
+//
+// Example usage:
+//
+//     Sharded::Transform<float, 4096, 4096> fft(4);
+//     std::complex<float>* data = fft.data();
+//     // Fill data[0..N1*N2-1]
+//     fft.dft();
+
+#ifndef fftbench_sharded_hpp
+#define fftbench_sharded_hpp
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <vector>
+#include <functional>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "fourstep.hpp"
+
+namespace Sharded {
+
+    // Barrier for processes sharing the memory it lives in.
+    // The mutex is robust so a process dying with it held can't hang the rest.
+    class Barrier {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        unsigned count;
+        unsigned waiting;
+        unsigned generation;
+    public:
+        void init(unsigned n) {
+            pthread_mutexattr_t ma;
+            pthread_mutexattr_init(&ma);
+            pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&mutex, &ma);
+            pthread_mutexattr_destroy(&ma);
+            pthread_condattr_t ca;
+            pthread_condattr_init(&ca);
+            pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+            pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+            pthread_cond_init(&cond, &ca);
+            pthread_condattr_destroy(&ca);
+            count = n;
+            waiting = 0;
+            generation = 0;
+        }
+        void destroy() {
+            pthread_cond_destroy(&cond);
+            pthread_mutex_destroy(&mutex);
+        }
+        /// Checks alive() every 100 ms while waiting. Returns false when
+        /// it reports a lost process or one died holding the mutex.
+        bool wait(const std::function<bool()>& alive = nullptr) {
+            int err = pthread_mutex_lock(&mutex);
+            unsigned gen = generation;
+            if (!err && ++waiting == count) {
+                waiting = 0;
+                ++generation;
+                pthread_cond_broadcast(&cond);
+            }
+            while (!err && gen == generation) {
+                if (!alive) {
+                    err = pthread_cond_wait(&cond, &mutex);
+                    continue;
+                }
+                timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                ts.tv_nsec += 100000000;
+                if (ts.tv_nsec >= 1000000000) {
+                    ts.tv_nsec -= 1000000000;
+                    ++ts.tv_sec;
+                }
+                err = pthread_cond_timedwait(&cond, &mutex, &ts);
+                if (err == ETIMEDOUT) err = alive() ? 0 : ETIMEDOUT;
+            }
+            if (err == EOWNERDEAD) pthread_mutex_consistent(&mutex);
+            if (!err || err == ETIMEDOUT || err == EOWNERDEAD) pthread_mutex_unlock(&mutex);
+            return !err;
+        }
+    };
+
+    /// A rank's view of the process group.
+    template<typename C>
+    class Comm {
+        Barrier* sync;
+        C* exchange;
+        unsigned my_rank;
+        unsigned ranks;
+        std::function<bool()> alive;
+    public:
+        /// alive() reports whether the other ranks are still running.
+        Comm(Barrier* sync, C* exchange, unsigned rank, unsigned size,
+             const std::function<bool()>& alive = nullptr) :
+            sync(sync), exchange(exchange), my_rank(rank), ranks(size), alive(alive) {
+        }
+        unsigned rank() const {
+            return my_rank;
+        }
+        unsigned size() const {
+            return ranks;
+        }
+        /// False when a rank was lost.
+        bool barrier() {
+            return sync->wait(alive);
+        }
+        /// Block d of send goes to rank d; block s of recv comes from rank s.
+        /// False when a rank was lost.
+        bool alltoall(const C* send, C* recv, size_t block) {
+            for (unsigned d = 0; d < ranks; ++d) {
+                std::copy(send + d * block, send + (d + 1) * block,
+                          exchange + (d * ranks + my_rank) * block);
+            }
+            if (!barrier()) return false;
+            std::copy(exchange + my_rank * ranks * block,
+                      exchange + (my_rank + 1) * ranks * block, recv);
+            return barrier();
+        }
+    };
+
+    template<typename T, size_t N1, size_t N2>
+    class Transform {
+        typedef std::complex<T> C;
+        static const size_t N = N1 * N2;
+
+        enum Command {
+            forward,
+            inverse,
+            quit
+        };
+        struct Control {
+            Barrier barrier;
+            int command;
+        };
+
+        unsigned procs;
+        void* segment = MAP_FAILED;
+        size_t length = 0;
+        Control* control = nullptr;
+        C* points = nullptr;
+        C* exchange = nullptr;
+        std::vector<pid_t> workers;
+        std::vector<C> send, recv;
+
+        // Move the [rows][cols] slab, split into procs column blocks, so
+        // that after alltoall each rank holds its columns as rows.
+        static bool transpose(Comm<C>& comm, C* slab, C* send, C* recv, size_t rows, size_t cols) {
+            const size_t p = comm.size();
+            const size_t rc = cols / p;
+            const size_t block = rows * rc;
+            for (size_t d = 0; d < p; ++d) {
+                for (size_t r = 0; r < rows; ++r) {
+                    for (size_t c = 0; c < rc; ++c) {
+                        send[d * block + c * rows + r] = slab[r * cols + d * rc + c];
+                    }
+                }
+            }
+            if (!comm.alltoall(send, recv, block)) return false;
+            for (size_t s = 0; s < p; ++s) {
+                for (size_t c = 0; c < rc; ++c) {
+                    std::copy(recv + s * block + c * rows, recv + s * block + (c + 1) * rows,
+                              slab + c * rows * p + s * rows);
+                }
+            }
+            return true;
+        }
+
+        template<int D>
+        static bool run(Comm<C>& comm, C* slab, C* send, C* recv) {
+            const size_t p = comm.size();
+            const size_t r1 = N1 / p;
+            const size_t r2 = N2 / p;
+            // Rows of x[n1][n2] to rows of t[n2][n1].
+            if (!transpose(comm, slab, send, recv, r1, N2)) return false;
+            for (size_t c = 0; c < r2; ++c) {
+                FourStep::transform<T, D, N1>(slab + c * N1);
+                FourStep::twiddle<T, D>(slab + c * N1, N1, comm.rank() * r2 + c, N);
+            }
+            // Rows of t[n2][k1] to rows of u[k1][n2].
+            if (!transpose(comm, slab, send, recv, r2, N1)) return false;
+            for (size_t r = 0; r < r1; ++r) {
+                FourStep::transform<T, D, N2>(slab + r * N2);
+            }
+            // Rows of u[k1][k2] to rows of X[k2][k1], the natural order.
+            return transpose(comm, slab, send, recv, r1, N2);
+        }
+
+        bool execute(unsigned rank, int command) {
+            std::function<bool()> watch;
+            if (rank == 0) watch = [this]() { return alive(); };
+            Comm<C> comm(&control->barrier, exchange, rank, procs, watch);
+            C* slab = points + rank * (N / procs);
+            bool ok;
+            if (command == forward) ok = run<-1>(comm, slab, send.data(), recv.data());
+            else ok = run<1>(comm, slab, send.data(), recv.data());
+            return ok && comm.barrier();
+        }
+
+        // Rank 0 watches for workers that exited or were killed.
+        bool alive() {
+            for (auto pid : workers) {
+                if (::waitpid(pid, nullptr, WNOHANG) != 0) return false;
+            }
+            return true;
+        }
+
+        // Kill the workers, which hold nothing worth a clean exit, and
+        // release the segment.
+        void abandon() {
+            for (auto pid : workers) {
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, nullptr, 0);
+            }
+            workers.clear();
+            ::munmap(segment, length);
+            segment = MAP_FAILED;
+        }
+
+        void serve(unsigned rank) {
+            send.assign(N / procs, C());
+            recv.assign(N / procs, C());
+            std::fill(points + rank * (N / procs), points + (rank + 1) * (N / procs), C());
+            if (!control->barrier.wait()) _exit(1);
+            for (;;) {
+                if (!control->barrier.wait()) _exit(1);
+                int command = control->command;
+                if (command == quit) _exit(0);
+                if (!execute(rank, command)) _exit(1);
+            }
+        }
+
+        bool command(Command c) {
+            if (!good()) return false;
+            control->command = c;
+            if (control->barrier.wait([this]() { return alive(); }) && execute(0, c)) return true;
+            abandon();
+            return false;
+        }
+
+    public:
+        /// Both N1 and N2 must be multiples of procs.
+        Transform(unsigned procs) : procs(procs) {
+            if (!procs || N1 % procs || N2 % procs) return;
+            length = sizeof(Control) + 2 * N * sizeof(C);
+            segment = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (segment == MAP_FAILED) return;
+            control = static_cast<Control*>(segment);
+            points = reinterpret_cast<C*>(control + 1);
+            exchange = points + N;
+            control->barrier.init(procs);
+            const pid_t parent = ::getpid();
+            for (unsigned rank = 1; rank < procs; ++rank) {
+                pid_t pid = ::fork();
+                if (pid == 0) {
+                    // Workers never outlive the process that forked them.
+#ifdef __linux__
+                    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+                    if (::getppid() != parent) _exit(1);
+                    serve(rank);
+                }
+                if (pid < 0) {
+                    // The started ranks wait for one that will never arrive.
+                    abandon();
+                    return;
+                }
+                workers.push_back(pid);
+            }
+            send.assign(N / procs, C());
+            recv.assign(N / procs, C());
+            std::fill(points, points + N / procs, C());
+            if (!control->barrier.wait([this]() { return alive(); })) abandon();
+        }
+
+        ~Transform() {
+            if (segment == MAP_FAILED) return;
+            control->command = quit;
+            control->barrier.wait();
+            for (auto pid : workers) ::waitpid(pid, nullptr, 0);
+            control->barrier.destroy();
+            ::munmap(segment, length);
+        }
+
+        Transform(const Transform&) = delete;
+        Transform& operator=(const Transform&) = delete;
+
+        bool good() const {
+            return segment != MAP_FAILED;
+        }
+
+        /// Process ids of ranks 1 and up.
+        const std::vector<pid_t>& pids() const {
+            return workers;
+        }
+
+        /// The N1*N2 points. Rank r owns data()[r*N/procs .. (r+1)*N/procs-1].
+        C* data() {
+            return points;
+        }
+
+        /// In-place discrete Fourier transform of data().
+        bool dft() {
+            return command(forward);
+        }
+
+        /// In-place inverse discrete Fourier transform of data().
+        bool idft() {
+            return command(inverse);
+        }
+    };
+
+}
+
+#endif
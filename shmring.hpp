@@ -0,0 +1,234 @@
+// Shared-memory spectrum publisher.
+//
+// One producer computes each spectrum once and publishes it into a ring
+// of slots in a POSIX shared memory object (/dev/shm on Linux). Any
+// number of processes map the same object read-only and read frames in
+// place without locks. Every slot is guarded by a sequence counter that
+// is odd while the producer is writing, so a reader detects a torn or
+// overwritten frame and simply tries again or skips ahead.
+//
+// Example producer:
+//
+//     ShmRing::Publisher<float, 1024> pub("/spectra", 64);
+//     auto& out = pub.acquire();
+//     FFT::dft(samples, out);
+//     pub.commit(time);
+//
+// Example consumer:
+//
+//     ShmRing::Subscriber<float, 1024> sub("/spectra");
+//     uint64_t frame = sub.head() - 1;
+//     sub.read(frame, [](double time, const std::array<std::complex<float>, 1024>& s) {
+//         // Use s in place. Discard results if read() returns false.
+//     });
+
+#ifndef fftbench_shmring_hpp
+#define fftbench_shmring_hpp
+
+#include <array>
+#include <atomic>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ShmRing {
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t value_size;
+        uint64_t bins;
+        uint64_t slots;
+        uint64_t slot_stride;
+        std::atomic<uint64_t> head;
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> seq;
+        uint64_t frame;
+        double time;
+    };
+
+    static_assert(sizeof(Slot) == 64, "Slot header must fill one cache line.");
+
+    // Atomics shared between processes must not hide a lock in each
+    // process's own memory.
+    static_assert(sizeof(uint64_t) == sizeof(long long) && ATOMIC_LLONG_LOCK_FREE == 2,
+                  "64-bit atomics must be lock free to share across processes.");
+
+    static const char magic[8] = {'F','F','T','R','I','N','G','\0'};
+    static const uint32_t version = 1;
+    static const size_t header_size = 64;
+
+    template<typename T, size_t N>
+    class Ring {
+    protected:
+        typedef std::array<std::complex<T>, N> Spectrum;
+        static const size_t slot_stride = (sizeof(Slot) + sizeof(Spectrum) + 63) & ~size_t(63);
+
+        unsigned char* base = nullptr;
+        size_t length = 0;
+
+        Header* header() const {
+            return reinterpret_cast<Header*>(base);
+        }
+        Slot* slot(uint64_t frame) const {
+            return reinterpret_cast<Slot*>(base + header_size + (frame % header()->slots) * slot_stride);
+        }
+        static Spectrum* data(Slot* s) {
+            return reinterpret_cast<Spectrum*>(s + 1);
+        }
+        bool map(int fd, size_t len, int prot) {
+            void* p = ::mmap(nullptr, len, prot, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) return false;
+            base = static_cast<unsigned char*>(p);
+            length = len;
+            return true;
+        }
+
+        Ring() {}
+        ~Ring() {
+            if (base) ::munmap(base, length);
+        }
+    public:
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        bool good() const {
+            return base != nullptr;
+        }
+
+        /// Number of frames published so far.
+        /// The newest frame is head()-1.
+        uint64_t head() const {
+            return header()->head.load(std::memory_order_acquire);
+        }
+
+        size_t slots() const {
+            return header()->slots;
+        }
+    };
+
+    /// Creates the shared memory object and writes frames into it.
+    /// There must be only one publisher for each name.
+    template<typename T, size_t N>
+    class Publisher : public Ring<T, N> {
+        typedef Ring<T, N> Base;
+        typedef typename Base::Spectrum Spectrum;
+        std::string name;
+        uint64_t frame = 0;
+        Slot* writing = nullptr;
+    public:
+        /// Name must start with a slash, like "/spectra".
+        Publisher(const std::string& name, size_t slots = 64) : name(name) {
+            if (slots < 2) slots = 2;
+            // Subscribers of an earlier publisher may still map the old
+            // object. Shrinking it would fault them, so replace it instead.
+            ::shm_unlink(name.c_str());
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+            if (fd < 0) return;
+            size_t len = header_size + slots * Base::slot_stride;
+            if (::ftruncate(fd, len) != 0 || !this->map(fd, len, PROT_READ | PROT_WRITE)) {
+                // Don't leave an empty object for subscribers to find.
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                return;
+            }
+            Header* h = this->header();
+            std::memcpy(h->magic, magic, sizeof(magic));
+            h->version = version;
+            h->value_size = sizeof(std::complex<T>);
+            h->bins = N;
+            h->slots = slots;
+            h->slot_stride = Base::slot_stride;
+            h->head.store(0, std::memory_order_release);
+            ::close(fd);
+        }
+
+        ~Publisher() {
+            if (this->good()) ::shm_unlink(name.c_str());
+        }
+
+        /// Claim the next slot so the transform can write straight into it.
+        /// Readers of this slot will fail until commit().
+        Spectrum& acquire() {
+            writing = this->slot(frame);
+            uint64_t seq = writing->seq.load(std::memory_order_relaxed);
+            writing->seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            writing->frame = frame;
+            return *Base::data(writing);
+        }
+
+        /// Publish the slot claimed by acquire().
+        void commit(double time) {
+            writing->time = time;
+            uint64_t seq = writing->seq.load(std::memory_order_relaxed);
+            writing->seq.store(seq + 1, std::memory_order_release);
+            this->header()->head.store(++frame, std::memory_order_release);
+            writing = nullptr;
+        }
+
+        /// Copy a finished spectrum into the ring.
+        void publish(double time, const Spectrum& spectrum) {
+            acquire() = spectrum;
+            commit(time);
+        }
+    };
+
+    /// Maps an existing ring read-only.
+    template<typename T, size_t N>
+    class Subscriber : public Ring<T, N> {
+        typedef Ring<T, N> Base;
+        typedef typename Base::Spectrum Spectrum;
+    public:
+        /// Fails when the object is missing or holds a different T or N.
+        Subscriber(const std::string& name) {
+            int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0) return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= header_size &&
+                this->map(fd, st.st_size, PROT_READ)) {
+                Header* h = this->header();
+                if (std::memcmp(h->magic, magic, sizeof(magic)) || h->version != version ||
+                    h->value_size != sizeof(std::complex<T>) || h->bins != N ||
+                    h->slot_stride != Base::slot_stride || h->slots < 2 ||
+                    header_size + h->slots * h->slot_stride > this->length) {
+                    ::munmap(this->base, this->length);
+                    this->base = nullptr;
+                }
+            }
+            ::close(fd);
+        }
+
+        /// Call visit(time, spectrum) on the frame in place.
+        /// Returns false, and the visitor must discard what it saw, when the
+        /// frame was being written, has been overwritten or is not published yet.
+        template<typename F>
+        bool read(uint64_t frame, F visit) const {
+            Slot* s = this->slot(frame);
+            uint64_t seq = s->seq.load(std::memory_order_acquire);
+            if (seq & 1) return false;
+            if (s->frame != frame || frame >= this->head()) return false;
+            visit(s->time, static_cast<const Spectrum&>(*Base::data(s)));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return s->seq.load(std::memory_order_relaxed) == seq;
+        }
+
+        /// Copy a frame out of the ring.
+        bool copy(uint64_t frame, double& time, Spectrum& spectrum) const {
+            return read(frame, [&](double t, const Spectrum& s) {
+                time = t;
+                spectrum = s;
+            });
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,399 @@
+// Indexed on-disk spectrogram format.
+//
+// Frames of FFT::dft output are stored as power spectra with a fixed
+// stride so any frame can be addressed directly in a memory map. Frames
+// are grouped into chunks and a time index is written at the end of the
+// file, so a reader can locate a time window with two binary searches
+// and then touch only the bytes of the requested time-frequency tile.
+//
+// File layout:
+//
+//     Header            64 bytes, padded to data_offset
+//     Frames            frames * stride bytes, starting at data_offset
+//     Chunk index       chunks * sizeof(Chunk), starting at index_offset
+//     Frame times       frames * sizeof(double), after the chunk index
+//
+// Example usage:
+//
+//     Spectrogram::Writer<512> out("capture.spec", Spectrogram::float16);
+//     out.write(time, spectrum);   // spectrum from FFT::dft
+//     out.close();
+//
+//     Spectrogram::Reader in("capture.spec");
+//     std::vector<float> tile;
+//     in.tile(t0, t1, bin0, bin1, tile);
+
+#ifndef fftbench_spectrogram_hpp
+#define fftbench_spectrogram_hpp
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Spectrogram {
+
+    // Storage for each bin.
+    enum Format : uint32_t {
+        float32 = 0, // Linear power as IEEE single.
+        float16 = 1, // Linear power as IEEE half.
+        decibel8 = 2 // Power in dB quantized to 8 bits.
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint64_t bins;
+        uint64_t stride;
+        uint64_t frames;
+        uint64_t chunks;
+        uint64_t index_offset;
+        float db_floor;
+        float db_step;
+    };
+    static_assert(sizeof(Header) == 64, "Spectrogram header must be 64 bytes.");
+
+    struct Chunk {
+        double begin;
+        double end;
+        uint64_t first;
+        uint64_t frames;
+    };
+
+    static const char magic[8] = {'F','F','T','S','P','E','C','\0'};
+    static const uint32_t version = 1;
+    static const uint64_t data_offset = 4096;
+
+    inline size_t element_size(uint32_t format) {
+        return format == float32 ? 4 : format == float16 ? 2 : 1;
+    }
+
+    // r = a * b + c, or false if that does not fit in 64 bits.
+    inline bool multiply_add(uint64_t a, uint64_t b, uint64_t c, uint64_t& r) {
+        if (b && a > (UINT64_MAX - c) / b) return false;
+        r = a * b + c;
+        return true;
+    }
+
+    // Frames start on cache line boundaries.
+    inline uint64_t frame_stride(uint64_t bins, uint32_t format) {
+        return (bins * element_size(format) + 63) & ~uint64_t(63);
+    }
+
+    // IEEE half precision conversion, round to nearest even.
+    inline uint16_t half(float f) {
+        uint32_t x;
+        std::memcpy(&x, &f, 4);
+        uint32_t sign = (x >> 16) & 0x8000;
+        int32_t exp = ((x >> 23) & 0xff) - 127 + 15;
+        uint32_t mant = x & 0x7fffff;
+        if (((x >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+        if (exp >= 0x1f) return sign | 0x7c00;
+        if (exp <= 0) {
+            if (exp < -10) return sign;
+            mant |= 0x800000;
+            uint32_t shift = 14 - exp;
+            uint32_t h = mant >> shift;
+            uint32_t rem = mant & ((1u << shift) - 1);
+            uint32_t mid = 1u << (shift - 1);
+            if (rem > mid || (rem == mid && (h & 1))) ++h;
+            return sign | h;
+        }
+        uint32_t h = (exp << 10) | (mant >> 13);
+        uint32_t rem = mant & 0x1fff;
+        if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h;
+        return sign | h;
+    }
+
+    inline float unhalf(uint16_t h) {
+        uint32_t sign = uint32_t(h & 0x8000) << 16;
+        uint32_t exp = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+        uint32_t x;
+        if (exp == 0x1f) {
+            x = sign | 0x7f800000 | (mant << 13);
+        } else if (exp) {
+            x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+        } else if (mant) {
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                --exp;
+            }
+            x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        } else {
+            x = sign;
+        }
+        float f;
+        std::memcpy(&f, &x, 4);
+        return f;
+    }
+
+    /// Streams frames to a spectrogram file.
+    /// The index is written by close() or the destructor.
+    template<size_t N>
+    class Writer {
+        int fd = -1;
+        Header header;
+        std::vector<Chunk> chunks;
+        std::vector<double> times;
+        std::vector<unsigned char> frame;
+        uint64_t chunk_frames;
+        bool ok = false;
+
+        bool put(const void* buf, size_t len, uint64_t offset) {
+            auto p = static_cast<const char*>(buf);
+            while (len) {
+                auto n = ::pwrite(fd, p, len, offset);
+                if (n <= 0) return false;
+                p += n;
+                len -= n;
+                offset += n;
+            }
+            return true;
+        }
+
+        void encode(size_t bin, float power) {
+            switch (header.format) {
+                case float32:
+                    std::memcpy(&frame[bin * 4], &power, 4);
+                    break;
+                case float16: {
+                    uint16_t h = half(power);
+                    std::memcpy(&frame[bin * 2], &h, 2);
+                    break;
+                }
+                default: {
+                    float db = power > 0 ? 10 * std::log10(power) : header.db_floor;
+                    float q = std::round((db - header.db_floor) / header.db_step);
+                    frame[bin] = q < 0 ? 0 : q > 255 ? 255 : static_cast<unsigned char>(q);
+                }
+            }
+        }
+
+    public:
+        Writer(const std::string& path, Format format = float32, size_t chunk_frames = 256,
+               float db_floor = -120, float db_step = 1) :
+            chunk_frames(chunk_frames ? chunk_frames : 1) {
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.format = format;
+            header.bins = N;
+            header.stride = frame_stride(N, format);
+            header.db_floor = db_floor;
+            header.db_step = db_step;
+            frame.resize(header.stride);
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            ok = fd >= 0 && put(&header, sizeof(header), 0);
+        }
+
+        ~Writer() {
+            close();
+        }
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool good() const {
+            return ok;
+        }
+
+        /// Append the power spectrum of one transform.
+        /// Times must not decrease.
+        template<typename T>
+        void write(double time, const std::array<std::complex<T>, N>& spectrum) {
+            if (!ok) return;
+            for (size_t i = 0; i < N; ++i) {
+                encode(i, static_cast<float>(std::norm(spectrum[i])));
+            }
+            uint64_t f = header.frames;
+            ok = put(frame.data(), frame.size(), data_offset + f * header.stride);
+            if (chunks.empty() || chunks.back().frames == chunk_frames) {
+                chunks.push_back(Chunk{time, time, f, 0});
+            }
+            chunks.back().end = time;
+            ++chunks.back().frames;
+            times.push_back(time);
+            ++header.frames;
+        }
+
+        /// Write the index and header. Returns false on any I/O error.
+        bool close() {
+            if (fd < 0) return ok;
+            header.chunks = chunks.size();
+            header.index_offset = data_offset + header.frames * header.stride;
+            uint64_t times_offset = header.index_offset + chunks.size() * sizeof(Chunk);
+            ok = ok && put(chunks.data(), chunks.size() * sizeof(Chunk), header.index_offset);
+            ok = ok && put(times.data(), times.size() * sizeof(double), times_offset);
+            ok = ok && ::ftruncate(fd, times_offset + times.size() * sizeof(double)) == 0;
+            ok = ok && put(&header, sizeof(header), 0);
+            ok = (::close(fd) == 0) && ok;
+            fd = -1;
+            return ok;
+        }
+    };
+
+    /// Memory maps a spectrogram file for random access.
+    class Reader {
+        const unsigned char* base = nullptr;
+        size_t length = 0;
+        const Header* header = nullptr;
+        const Chunk* index = nullptr;
+        const double* times = nullptr;
+
+        float decode(const unsigned char* p) const {
+            switch (header->format) {
+                case float32: {
+                    float f;
+                    std::memcpy(&f, p, 4);
+                    return f;
+                }
+                case float16: {
+                    uint16_t h;
+                    std::memcpy(&h, p, 2);
+                    return unhalf(h);
+                }
+                default:
+                    return std::pow(10.0f, (header->db_floor + *p * header->db_step) / 10);
+            }
+        }
+
+    public:
+        Reader() {}
+
+        Reader(const std::string& path) {
+            open(path);
+        }
+
+        ~Reader() {
+            close();
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        /// Returns false when the file is missing, truncated or not a spectrogram.
+        bool open(const std::string& path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= data_offset) {
+                void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) {
+                    base = static_cast<const unsigned char*>(p);
+                    length = st.st_size;
+                }
+            }
+            ::close(fd);
+            if (!base) return false;
+            header = reinterpret_cast<const Header*>(base);
+            // Sizes come from the file, so every sum is checked for overflow.
+            uint64_t data_end = 0, times_offset = 0, end = 0;
+            bool valid = !std::memcmp(header->magic, magic, sizeof(magic)) && header->version == version &&
+                header->format <= decibel8 && header->bins <= (UINT64_MAX - 63) / 4 &&
+                header->stride == frame_stride(header->bins, header->format) &&
+                multiply_add(header->frames, header->stride, data_offset, data_end) &&
+                header->index_offset == data_end &&
+                multiply_add(header->chunks, sizeof(Chunk), header->index_offset, times_offset) &&
+                multiply_add(header->frames, sizeof(double), times_offset, end) && end <= length;
+            if (valid) {
+                index = reinterpret_cast<const Chunk*>(base + header->index_offset);
+                times = reinterpret_cast<const double*>(base + times_offset);
+                for (uint64_t c = 0; c < header->chunks && valid; ++c) {
+                    valid = index[c].first <= header->frames && index[c].frames <= header->frames - index[c].first;
+                }
+            }
+            if (!valid) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            if (base) ::munmap(const_cast<unsigned char*>(base), length);
+            base = nullptr;
+            header = nullptr;
+            index = nullptr;
+            times = nullptr;
+            length = 0;
+        }
+
+        bool is_open() const {
+            return base != nullptr;
+        }
+
+        /// Zero when no file is open.
+        size_t bins() const {
+            return header ? header->bins : 0;
+        }
+
+        size_t frames() const {
+            return header ? header->frames : 0;
+        }
+
+        Format format() const {
+            return header ? static_cast<Format>(header->format) : float32;
+        }
+
+        /// Zero when no file is open.
+        double time(size_t frame) const {
+            return is_open() ? times[frame] : 0;
+        }
+
+        /// Raw frame storage, encoded per format(). Null when no file is open.
+        const void* frame(size_t frame) const {
+            if (!is_open()) return nullptr;
+            return base + data_offset + frame * header->stride;
+        }
+
+        /// Index of the first frame at or after time t.
+        size_t seek(double t) const {
+            if (!is_open()) return 0;
+            const Chunk* end = index + header->chunks;
+            const Chunk* c = std::lower_bound(index, end, t, [](const Chunk& c, double t) {
+                return c.end < t;
+            });
+            if (c == end) return header->frames;
+            const double* first = times + c->first;
+            return std::lower_bound(first, first + c->frames, t) - times;
+        }
+
+        /// Decode power for frames with time in [t0, t1) and bins in [bin0, bin1).
+        /// The tile is stored row major, one row per frame. Returns the frame count.
+        size_t tile(double t0, double t1, size_t bin0, size_t bin1,
+                    std::vector<float>& out, std::vector<double>* tile_times = nullptr) const {
+            out.clear();
+            if (tile_times) tile_times->clear();
+            if (!is_open()) return 0;
+            if (bin1 > header->bins) bin1 = header->bins;
+            if (bin0 >= bin1) return 0;
+            size_t width = bin1 - bin0;
+            size_t size = element_size(header->format);
+            size_t f = seek(t0);
+            size_t f0 = f;
+            for (; f < header->frames && times[f] < t1; ++f) {
+                auto p = static_cast<const unsigned char*>(frame(f)) + bin0 * size;
+                for (size_t i = 0; i < width; ++i) {
+                    out.push_back(decode(p + i * size));
+                }
+                if (tile_times) tile_times->push_back(times[f]);
+            }
+            return f - f0;
+        }
+    };
+
+}
+
+#endif
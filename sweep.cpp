@@ -0,0 +1,103 @@
+// Benchmarks of every implementation across sizes and types.
+// Separate from main.cpp because the largest sizes take minutes
+// and a lot of memory.
+// Run with:
+// g++ -o sweep -std=c++11 -O3 -pthread sweep.cpp && ./sweep
+
+#include <array>
+
+#include "benchtest/benchtest.hpp"
+#include "four1.hpp"
+#include "four1plus.hpp"
+#include "four1tmpl.hpp"
+#include "fft.hpp"
+#include "testsignal.hpp"
+
+int main(int argc, char** argv) {
+    testing::reporter(testing::NewReporter());
+    return testing::Runner::RunAll(argc, argv);
+}
+
+template<typename T, size_t N>
+class Sweep : public testing::Test {
+    TestSignal<T, N> signal;
+    std::array<std::complex<T>, N> *data;
+protected:
+    Sweep() :
+        data(new std::array<std::complex<T>, N>()) {
+        // Sizes that take many milliseconds would otherwise run for minutes.
+        policy.max_time = 2;
+    }
+    ~Sweep() {
+        delete data;
+    }
+
+    void four1() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            ::four1(reinterpret_cast<T*>(data), N);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void four1plus() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            ::four1plus(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void four1tmpl() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            Four1tmpl<std::complex<T>, N>::fft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void fft() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            FFT::Transform<T, N, FFT::Butterfly>::dft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void breadthfirst() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            FFT::Transform<T, N, FFT::BreadthFirst>::dft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    // FFT::Auto, so the FFT_BREADTH_FIRST_MAX crossover can be checked
+    // against the breadthfirst and fft rows.
+    void automatic() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            FFT::Transform<T, N, FFT::Auto>::dft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+    void hybrid() {
+        while (Benchmark()) {
+            signal.refresh(*data, timer);
+            FFT::Transform<T, N, FFT::Hybrid>::dft(*data);
+            testing::DoNotOptimize(*data);
+        }
+    }
+
+};
+
+TEST_P(Sweep, four1);
+TEST_P(Sweep, four1plus);
+TEST_P(Sweep, four1tmpl);
+TEST_P(Sweep, fft);
+TEST_P(Sweep, breadthfirst);
+TEST_P(Sweep, automatic);
+TEST_P(Sweep, hybrid);
+
+INSTANTIATE_TEST_P(Sweep, 8, 1 << 22, float, double, long double);
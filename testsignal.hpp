@@ -0,0 +1,63 @@
+// Input for benchmarks of in-place transforms.
+//
+// Timing an in-place transform over and over would transform its own
+// output, which grows every pass until it overflows, while an all-zero
+// input hides any denormal or data dependent costs. TestSignal keeps a
+// pseudo random signal, the same on every run, and copies it back into
+// the data before each pass with the timing paused.
+//
+// Example usage with a Sampler, or a Test's timer:
+//
+//     TestSignal<float, 4096> signal;
+//     testing::Sampler s;
+//     while (s.Next()) {
+//         signal.refresh(data, s);
+//         FFT::dft(data);
+//     }
+
+#ifndef fftbench_testsignal_hpp
+#define fftbench_testsignal_hpp
+
+#include <array>
+#include <complex>
+#include <random>
+
+template<typename T, size_t N>
+class TestSignal {
+public:
+    typedef std::array<std::complex<T>, N> Array;
+
+private:
+    Array* signal;
+
+public:
+    /// Real and imaginary parts uniform in [-1, 1).
+    TestSignal() : signal(new Array) {
+        std::minstd_rand rand;
+        std::uniform_real_distribution<T> uniform(-1, 1);
+        for (auto& x : *signal) {
+            x = std::complex<T>(uniform(rand), uniform(rand));
+        }
+    }
+
+    ~TestSignal() {
+        delete signal;
+    }
+
+    TestSignal(const TestSignal&) = delete;
+    TestSignal& operator=(const TestSignal&) = delete;
+
+    const Array& operator*() const {
+        return *signal;
+    }
+
+    /// Copy the signal into data between timer.Pause() and timer.Resume().
+    template<typename Timer>
+    void refresh(Array& data, Timer& timer) const {
+        timer.Pause();
+        data = *signal;
+        timer.Resume();
+    }
+};
+
+#endif
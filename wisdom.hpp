@@ -0,0 +1,183 @@
+// Persistent wisdom for the auto-tuning planner.
+//
+// Saves every Plan::decisions() entry, with the timing of each
+// candidate, to a small binary file of fixed-size records. Loading maps
+// the file and copies the records back, so a process can start with
+// tuned kernels instead of timing them again. Files are stamped with a
+// hardware signature made from the CPU model and feature flags; when it
+// does not match the running machine the file is ignored and sizes are
+// tuned on first use as usual.
+//
+// Example usage:
+//
+//     if (!Wisdom::load("fft.wisdom")) {
+//         Plan::Planner<float, 4096>::tune();
+//         Wisdom::save("fft.wisdom");
+//     }
+
+#ifndef fftbench_wisdom_hpp
+#define fftbench_wisdom_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "planner.hpp"
+
+namespace Wisdom {
+
+    static const char magic[8] = {'F','F','T','W','I','S','D','M'};
+    static const uint32_t version = 1;
+    static const size_t max_timings = 8;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t records;
+        uint64_t hash;
+        char signature[232];
+    };
+
+    struct Timing {
+        char name[24];
+        double us;
+    };
+
+    struct Record {
+        char key[40];
+        char kernel[24];
+        uint32_t timings;
+        uint32_t reserved;
+        Timing timing[max_timings];
+    };
+
+    static_assert(sizeof(Header) == 256, "Wisdom header must be 256 bytes.");
+
+    /// CPU model and feature flags of this machine.
+    inline std::string signature() {
+        std::ostringstream s;
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned a = 0, b = 0, c = 0, d = 0;
+        unsigned brand[12] = {0};
+        if (__get_cpuid(0x80000000, &a, &b, &c, &d) && a >= 0x80000004) {
+            for (unsigned i = 0; i < 3; ++i) {
+                __get_cpuid(0x80000002 + i, &brand[i*4], &brand[i*4+1], &brand[i*4+2], &brand[i*4+3]);
+            }
+        }
+        auto model = reinterpret_cast<const char*>(brand);
+        s << std::string(model, strnlen(model, sizeof(brand)));
+        __get_cpuid(1, &a, &b, &c, &d);
+        s << std::hex << ";1:" << c << ":" << d;
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, a, b, c, d);
+            s << ";7:" << b << ":" << c << ":" << d;
+        }
+#else
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (!line.compare(0, 10, "model name") || !line.compare(0, 5, "flags") ||
+                !line.compare(0, 8, "Features") || !line.compare(0, 8, "CPU part")) {
+                s << line << ";";
+            }
+            if (line.empty() && s.tellp() > 0) break;
+        }
+#endif
+        return s.str();
+    }
+
+    // FNV-1a
+    inline uint64_t hash(const std::string& s) {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char ch : s) {
+            h ^= ch;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    inline void copy(char* dst, const std::string& src, size_t size) {
+        std::memset(dst, 0, size);
+        std::memcpy(dst, src.c_str(), std::min(src.size(), size - 1));
+    }
+
+    /// Write all planner decisions. Replaces the file atomically.
+    inline bool save(const std::string& path) {
+        auto sig = signature();
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, magic, sizeof(magic));
+        h.version = version;
+        h.records = Plan::decisions().size();
+        h.hash = hash(sig);
+        copy(h.signature, sig, sizeof(h.signature));
+        std::string tmp = path + ".tmp";
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        for (auto& d : Plan::decisions()) {
+            Record r;
+            std::memset(&r, 0, sizeof(r));
+            copy(r.key, d.first, sizeof(r.key));
+            copy(r.kernel, d.second.kernel, sizeof(r.kernel));
+            for (auto& t : d.second.timings) {
+                if (r.timings == max_timings) break;
+                copy(r.timing[r.timings].name, t.first, sizeof(r.timing[0].name));
+                r.timing[r.timings++].us = t.second;
+            }
+            ok = ok && std::fwrite(&r, sizeof(r), 1, f) == 1;
+        }
+        ok = (std::fclose(f) == 0) && ok;
+        if (ok) ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+        if (!ok) std::remove(tmp.c_str());
+        return ok;
+    }
+
+    /// Add the decisions in a wisdom file to Plan::decisions().
+    /// Call before the first transform of a size to skip its tuning.
+    /// Returns false, changing nothing, if the file is missing, damaged
+    /// or was made on hardware with a different signature.
+    inline bool load(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+            p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        auto h = static_cast<const Header*>(p);
+        auto records = reinterpret_cast<const Record*>(h + 1);
+        bool ok = !std::memcmp(h->magic, magic, sizeof(magic)) && h->version == version &&
+                  sizeof(Header) + h->records * sizeof(Record) == size_t(st.st_size) &&
+                  h->hash == hash(signature());
+        for (uint32_t i = 0; ok && i < h->records; ++i) {
+            auto& r = records[i];
+            Plan::Decision d;
+            d.kernel.assign(r.kernel, strnlen(r.kernel, sizeof(r.kernel)));
+            for (uint32_t t = 0; t < r.timings && t < max_timings; ++t) {
+                d.timings.push_back(std::make_pair(
+                    std::string(r.timing[t].name, strnlen(r.timing[t].name, sizeof(r.timing[t].name))),
+                    r.timing[t].us));
+            }
+            Plan::decisions()[std::string(r.key, strnlen(r.key, sizeof(r.key)))] = d;
+        }
+        ::munmap(p, st.st_size);
+        return ok;
+    }
+
+}
+
+#endif